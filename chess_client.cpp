@@ -2,32 +2,1157 @@
 A simple chess client featuring a minimax evaluation engine.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//opening books and endgame tables are mapped into memory rather than read, so even very large ones open at once
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//the pext instruction (BMI2) indexes the slider tables when the processor has it; build with -DNO_PEXT to always use magics
+#if !defined(NO_PEXT) && (defined(__x86_64__) || defined(_M_X64))
+#define PEXT_BUILD
+#if defined(_MSC_VER)
+#include <immintrin.h>
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
+//search statistics are counted unless built with -DNO_STATS, when the counting compiles to nothing
+#if !defined(NO_STATS)
+#define STATS_BUILD
+#define STAT(statement) statement
+#else
+#define STAT(statement)
+#endif
+
+//the network evaluator has AVX2 and SSE4.1 kernels, picked at startup for the processor; build with -DNO_SIMD for only the plain loops
+#if !defined(NO_SIMD) && (defined(__x86_64__) || defined(_M_X64))
+#define SIMD_BUILD
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#define TARGET(isa)
+#else
+#define TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+//bitboard utilities
+typedef unsigned long long Bitboard; //one bit per square, a1 = bit 0, h8 = bit 63
+int toSquare(int i, int j);
+int popCount(Bitboard b);
+int lsb(Bitboard b);
+int msb(Bitboard b);
+int popLsb(Bitboard& b);
+void initAttacks();
+Bitboard rayAttacks(int direction, int square, Bitboard occupied);
+Bitboard rookAttacks(int square, Bitboard occupied);
+Bitboard bishopAttacks(int square, Bitboard occupied);
+struct Magic
+{
+	Bitboard mask; //squares whose occupancy changes the attacks, board edges excluded
+	Bitboard magic; //multiplier hashing every occupancy of the mask to an index that cannot give wrong attacks
+	Bitboard* attacks; //this square's part of the attack table
+	int shift;
+};
+void initSliders(Magic* magics, Bitboard* table, const int* directions);
+int sliderIndex(const Magic& magic, Bitboard occupied);
+bool cpuHasPext();
+Bitboard pext(Bitboard b, Bitboard mask);
+Magic rookMagics[64];
+Magic bishopMagics[64];
+Bitboard rookTable[102400]; //one entry per occupancy of each square's mask, 2^10 to 2^12 a square
+Bitboard bishopTable[5248];
+bool usePext; //index the tables with pext rather than a magic multiply
+Bitboard knightAttacks[64];
+Bitboard kingAttacks[64];
+Bitboard pawnAttacks[2][64]; //[0] attacks of a pawn moving up the board, [1] down the board
+Bitboard rays[8][64]; //directions 0-3 run towards higher squares, 4-7 towards lower squares
+Bitboard between[64][64]; //squares strictly between two squares sharing a line, 0 if they share none
+Bitboard lineThrough[64][64]; //the whole rank, file or diagonal through two squares, 0 if they share none
+const int NO_SQUARE = 64;
+
+//hashing utilities
+typedef unsigned long long Key;
+void initZobrist();
+Key randomKey();
+Key zobristPieces[13][64];
+Key zobristSide; //set when black is to move
+Key zobristCastling[16];
+Key zobristEnPassant[8]; //by file
+
 //board utilities
-void initBoard();
-void initTestBoard();
-void drawBoard();
-void flipBoard();
-std::vector<std::vector<int>> board(8, std::vector<int>(8));
+enum Side { WHITE, BLACK };
+enum PieceType { PAWN = 1, ROOK, KNIGHT, BISHOP, QUEEN, KING }; //piece codes are 2 * type - 1 for white, 2 * type for black
+enum Castling { WHITE_KINGSIDE = 1, WHITE_QUEENSIDE = 2, BLACK_KINGSIDE = 4, BLACK_QUEENSIDE = 8 };
+typedef unsigned short Move; //from square in bits 0-5, to square in bits 6-11, flags in bits 12-15
+enum MoveFlags { QUIET, DOUBLE_PUSH, KING_CASTLE, QUEEN_CASTLE, CAPTURE, EN_PASSANT, PROMOTION = 8 }; //promotions add 0-3 for the piece, and CAPTURE when taking
+const Move NO_MOVE = 0; //a1a1, never a real move
+const int promotionTypes[4] = { KNIGHT, BISHOP, ROOK, QUEEN };
+Move encodeMove(int from, int to, int flags);
+int moveFrom(Move move);
+int moveTo(Move move);
+int moveFlags(Move move);
+int promotionType(Move move); //piece type the pawn becomes, 0 if not a promotion
+bool isCapture(Move move);
+std::string moveText(Move move);
+const int NNUE_HIDDEN = 256; //width of the network's first layer, for each side's view of the board
+struct Position
+{
+	Bitboard pieces[13]; //one bitboard per piece code, index 0 unused
+	Bitboard sides[2]; //[0] white (odd) pieces, [1] black (even) pieces
+	Bitboard occupied;
+	int squares[64]; //piece code on each square, 0 if empty
+	int kingSquares[2] = { NO_SQUARE, NO_SQUARE }; //kept up to date as kings are put and removed
+	int mg[2]; //material and piece-square sums of each side for the middlegame, kept up to date by putPiece and removePiece
+	int eg[2]; //and for the endgame
+	int phase; //non-pawn material left, 24 at the start, tapering the evaluation from middlegame to endgame
+	alignas(32) int16_t accumulator[2][NNUE_HIDDEN]; //the network's first layer seen by white and by black, less its bias, kept up to date while a network is in use
+	Key key; //zobrist key of the pieces, side to move, castling rights and en passant square
+	int side; //the side to move
+	int castling; //castling rights still available
+	int epSquare = NO_SQUARE; //square a pawn may capture en passant onto
+	int halfmoves; //plies since the last capture or pawn move
+	int moveCounter; //plies played
+};
+struct Undo
+{
+	//everything makeMove overwrites that cannot be worked out again from the move itself
+	int captured; //piece code taken, 0 if none
+	int promoted; //piece code the pawn became, 0 if none
+	int castling;
+	int epSquare;
+	int halfmoves;
+	Key key;
+};
+void initBoard(Position& pos);
+void initTestBoard(Position& pos);
+void drawBoard(const Position& pos);
+int pieceType(int piece);
+int pieceSide(int piece);
+int makePiece(int type, int side);
+void putPiece(Position& pos, int piece, int square);
+void removePiece(Position& pos, int square);
+void movePiece(Position& pos, int from, int to);
+void makeMove(Position& pos, Move move, Undo& undo);
+void unmakeMove(Position& pos, Move move, const Undo& undo);
+void makeNullMove(Position& pos, Undo& undo); //passes the move to the other side
+void unmakeNullMove(Position& pos, const Undo& undo);
+void playMoves(Position& pos, const std::string& moves);
+Move parseMove(Position& pos, const std::string& text); //NO_MOVE unless it is one of the available moves
+bool setFen(Position& pos, const std::string& fen);
+std::string fenText(const Position& pos);
+std::string sanText(Position& pos, Move move); //standard algebraic notation, as PGN and EPD record moves
+Move parseSan(Position& pos, const std::string& text); //NO_MOVE unless it names one of the available moves, in algebraic or coordinate notation
+void startGame(Position& pos); //the position given with "--fen", or the standard start position
+Position board; //the game being played
+std::string START_FEN; //where games in the menu start, the standard position if empty
+int castlingMask[64]; //rights kept when a piece moves from or to each square
+
+bool inCheck(const Position& pos);
+bool squareAttacked(const Position& pos, int square, int bySide); //looks outward from the square through the attack tables
+Bitboard attackersTo(const Position& pos, int square, Bitboard occupied); //pieces of both sides, sliders seeing through to the given occupancy
+const int pieceValues[13] = { 0, 100, 100, 500, 500, 320, 320, 330, 330, 900, 900, 0, 0 }; //centipawns, for pruning and ordering
+int see(const Position& pos, Move move); //static exchange evaluation: material won by the move once every capture on its square has been played out
 
-bool inCheck();
-int value(int i, int j);
+const int MAX_MOVES = 256; //more than any position has
+struct MoveList
+{
+	//filled in place by the generator, so a node's moves live on its stack frame rather than the heap
+	Move moves[MAX_MOVES];
+	int size = 0;
+};
+void logMoves(Position& pos, MoveList& log, bool capturesOnly = false); //captures and promotions only for the quiescence search
+void addMove(MoveList& log, Move move);
+void addPromotions(MoveList& log, int from, int to, int flags);
+
+//evaluation utilities
+void initEvaluation();
+int evaluate(const Position& pos); //centipawns from the point of view of the side to move
+int mgPieceSquare[13][64]; //material plus piece-square bonus of each piece on each square
+int egPieceSquare[13][64];
+const int phaseWeights[7] = { 0, 0, 2, 1, 1, 4, 0 }; //by piece type
+const int mgMaterial[7] = { 0, 82, 477, 337, 365, 1025, 0 };
+const int egMaterial[7] = { 0, 94, 512, 281, 297, 936, 0 };
+//piece-square tables as seen by white, rank 8 first
+const int pawnSquaresMg[64] = {
+	0, 0, 0, 0, 0, 0, 0, 0,
+	50, 50, 50, 50, 50, 50, 50, 50,
+	10, 10, 20, 30, 30, 20, 10, 10,
+	5, 5, 10, 25, 25, 10, 5, 5,
+	0, 0, 0, 20, 20, 0, 0, 0,
+	5, -5, -10, 0, 0, -10, -5, 5,
+	5, 10, 10, -20, -20, 10, 10, 5,
+	0, 0, 0, 0, 0, 0, 0, 0
+};
+const int pawnSquaresEg[64] = {
+	0, 0, 0, 0, 0, 0, 0, 0,
+	80, 80, 80, 80, 80, 80, 80, 80,
+	50, 50, 50, 50, 50, 50, 50, 50,
+	30, 30, 30, 30, 30, 30, 30, 30,
+	15, 15, 15, 15, 15, 15, 15, 15,
+	5, 5, 5, 5, 5, 5, 5, 5,
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0
+};
+const int knightSquares[64] = {
+	-50, -40, -30, -30, -30, -30, -40, -50,
+	-40, -20, 0, 0, 0, 0, -20, -40,
+	-30, 0, 10, 15, 15, 10, 0, -30,
+	-30, 5, 15, 20, 20, 15, 5, -30,
+	-30, 0, 15, 20, 20, 15, 0, -30,
+	-30, 5, 10, 15, 15, 10, 5, -30,
+	-40, -20, 0, 5, 5, 0, -20, -40,
+	-50, -40, -30, -30, -30, -30, -40, -50
+};
+const int bishopSquares[64] = {
+	-20, -10, -10, -10, -10, -10, -10, -20,
+	-10, 0, 0, 0, 0, 0, 0, -10,
+	-10, 0, 5, 10, 10, 5, 0, -10,
+	-10, 5, 5, 10, 10, 5, 5, -10,
+	-10, 0, 10, 10, 10, 10, 0, -10,
+	-10, 10, 10, 10, 10, 10, 10, -10,
+	-10, 5, 0, 0, 0, 0, 5, -10,
+	-20, -10, -10, -10, -10, -10, -10, -20
+};
+const int rookSquares[64] = {
+	0, 0, 0, 0, 0, 0, 0, 0,
+	5, 10, 10, 10, 10, 10, 10, 5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	-5, 0, 0, 0, 0, 0, 0, -5,
+	0, 0, 0, 5, 5, 0, 0, 0
+};
+const int queenSquares[64] = {
+	-20, -10, -10, -5, -5, -10, -10, -20,
+	-10, 0, 0, 0, 0, 0, 0, -10,
+	-10, 0, 5, 5, 5, 5, 0, -10,
+	-5, 0, 5, 5, 5, 5, 0, -5,
+	0, 0, 5, 5, 5, 5, 0, -5,
+	-10, 5, 5, 5, 5, 5, 0, -10,
+	-10, 0, 5, 0, 0, 0, 0, -10,
+	-20, -10, -10, -5, -5, -10, -10, -20
+};
+const int kingSquaresMg[64] = {
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-20, -30, -30, -40, -40, -30, -30, -20,
+	-10, -20, -20, -20, -20, -20, -20, -10,
+	20, 20, 0, 0, 0, 0, 20, 20,
+	20, 30, 10, 0, 0, 10, 30, 20
+};
+const int kingSquaresEg[64] = {
+	-50, -40, -30, -20, -20, -30, -40, -50,
+	-30, -20, -10, 0, 0, -10, -20, -30,
+	-30, -10, 20, 30, 30, 20, -10, -30,
+	-30, -10, 30, 40, 40, 30, -10, -30,
+	-30, -10, 30, 40, 40, 30, -10, -30,
+	-30, -10, 20, 30, 30, 20, -10, -30,
+	-30, -30, 0, 0, 0, 0, -30, -30,
+	-50, -30, -30, -30, -30, -30, -30, -50
+};
+const int* const mgSquares[7] = { nullptr, pawnSquaresMg, rookSquares, knightSquares, bishopSquares, queenSquares, kingSquaresMg };
+const int* const egSquares[7] = { nullptr, pawnSquaresEg, rookSquares, knightSquares, bishopSquares, queenSquares, kingSquaresEg };
+
+//neural network utilities
+const int NNUE_INPUTS = 768; //one input for each piece of each side on each square
+const int NNUE_QA = 255; //accumulator quantisation, where the activation clips
+const int NNUE_QB = 64; //output weight quantisation
+const int NNUE_SCALE = 400; //network output to centipawns
+struct Network
+{
+	//768 -> 256x2 -> 1 with a clipped relu, the layout the bullet trainer's simple example writes
+	alignas(32) int16_t featureWeights[NNUE_INPUTS][NNUE_HIDDEN]; //the accumulator column of each input
+	alignas(32) int16_t featureBias[NNUE_HIDDEN];
+	alignas(32) int16_t outputWeights[2 * NNUE_HIDDEN]; //the side to move's half first, then the other side's
+	int16_t outputBias;
+};
+enum Kernel { KERNEL_SCALAR, KERNEL_SSE41, KERNEL_AVX2 };
+bool loadNetwork(const std::string& path);
+void randomNetwork();
+int networkInput(int piece, int square, int view);
+void addFeature(Position& pos, int piece, int square);
+void removeFeature(Position& pos, int piece, int square);
+int evaluateNetwork(const Position& pos);
+int bestKernel();
+void accumulatorAdd(int16_t* accumulator, const int16_t* column);
+void accumulatorSub(int16_t* accumulator, const int16_t* column);
+int outputDot(const int16_t* accumulator, const int16_t* weights); //sum of the clipped accumulator plus bias times the weights
+void evalBenchmark(const std::string& path);
+Network network;
+bool useNetwork; //evaluate with the network rather than the handcrafted terms
+int networkKernel; //vector width the accumulator and output loops use
+const char* const kernelNames[3] = { "scalar", "sse4.1", "avx2" };
+const int networkTypes[7] = { 0, 0, 3, 1, 2, 4, 5 }; //our piece types in the network's pawn, knight, bishop, rook, queen, king order
 
-void logMoves();
-std::vector<int> moveLog;
-std::vector<int> bestMoves;
-int moveCounter;
+//transposition table utilities
+struct HashEntry
+{
+	Key key;
+	short score;
+	unsigned char depth;
+	unsigned char bound;
+	Move move; //best move found, NO_MOVE if none
+	unsigned char generation; //the search that last wrote the entry
+};
+struct HashSlot
+{
+	//the key is stored xored with the data, so a slot torn by two threads writing at once
+	//fails verification instead of returning another position's data
+	std::atomic<Key> check;
+	std::atomic<unsigned long long> data;
+};
+struct HashBucket
+{
+	HashSlot slots[4]; //one 64 byte cache line
+};
+enum Bound { BOUND_NONE, BOUND_UPPER, BOUND_LOWER, BOUND_EXACT };
+struct HashTable
+{
+	std::unique_ptr<HashBucket[]> buckets;
+	size_t size = 0; //buckets, a power of two
+	std::atomic<unsigned char> generation{ 0 }; //bumped by every search using the table, including those running alongside
+};
+void resizeHash(HashTable& table, int megabytes);
+void clearHash(HashTable& table);
+bool probeHash(const HashTable& table, Key key, HashEntry& entry);
+void storeHash(HashTable& table, Key key, int depth, int bound, int score, Move move);
+int hashFull(const HashTable& table);
+unsigned long long packEntry(int depth, int bound, int score, Move move, unsigned char generation);
+HashEntry unpackEntry(Key key, unsigned long long data);
+HashTable hashTable; //the table of the game being played, the UCI front end and the benchmarks
+int HASH_SIZE_MB = 16;
 
 //engine utilities
-void move(int depth);
-int maxEvaluation(int depth); //minimax evaluation
-int MAX_DEPTH = 3; //preset "thinking" depth of 3 turns
+enum Selectivity { NULL_MOVE = 1, LATE_REDUCTIONS = 2, REVERSE_FUTILITY = 4, FUTILITY = 8, RAZORING = 16, ALL_SELECTIVITY = 31 };
+const char* const selectivityNames[5] = { "nmp", "lmr", "rfp", "fp", "razor" }; //by bit, as "--selective" and self-play budgets name them
+int SELECTIVITY = ALL_SELECTIVITY; //selective search techniques in use unless a search's limits say otherwise
+struct SearchLimits
+{
+	int depth = 64; //deepest iteration to start
+	long long nodes = 0; //node budget, 0 for none
+	int moveTime = 3000; //milliseconds per move, 0 for none
+	bool infinite = false; //keep the result back until told to stop, even once the search has finished
+	int selectivity = SELECTIVITY; //Selectivity flags of the techniques the search may use
+};
+const int MAX_PLY = 128;
+const int CUTOFF_SLOTS = 8; //beta cutoffs are counted by the index of the move giving them, the last slot taking every later move
+struct SearchStats
+{
+	//written only by the thread that owns them
+	long long hashProbes;
+	long long hashHits;
+	long long hashCuts; //hits whose stored bound settled the node without a search
+	long long tablebaseHits; //nodes scored by the endgame tables
+	long long cutoffs[CUTOFF_SLOTS];
+	long long iterationNodes[MAX_PLY + 1]; //nodes and quiescence nodes searched by the end of each completed iteration
+};
+struct SearchContext;
+struct SearchThread
+{
+	int index; //0 for the main thread, which decides the move
+	SearchContext* context; //the search this thread is part of
+	Position board; //private copy of the position being searched
+	MoveList rootLog;
+	int rootScores[MAX_MOVES];
+	MoveList bestMoves; //moves tied for the best evaluation of the current iteration
+	MoveList chosenMoves; //best moves of the last completed iteration
+	int completedDepth; //deepest iteration finished
+	Move iterationMoves[MAX_PLY + 1]; //move chosen by each completed iteration
+	long long iterationTimes[MAX_PLY + 1]; //milliseconds from the start to the end of each completed iteration
+	std::atomic<long long> nodes; //only written by the owning thread
+	std::atomic<long long> qnodes; //quiescence nodes, counted apart from the main search
+	long long allocations; //heap allocations made while searching, which should be none
+	SearchStats stats;
+	Move plyMoves[MAX_PLY + 1]; //the move that led to each ply of the line being searched, NO_MOVE after a null move
+	int nullMinPly; //null moves are not tried below this ply while a null move cutoff is being verified
+	Move killers[MAX_PLY][2]; //the last two quiet moves to give a beta cutoff at each ply
+	Move counterMoves[13][64]; //the quiet move that last refuted each piece arriving on each square
+	int history[2][64][64]; //for each side, from and to square, how often the quiet move gave a cutoff less how often it was tried and did not
+};
+struct SearchContext
+{
+	//everything the threads of one search share, so that several searches can run at once
+	SearchLimits limits; //budget of the search in progress
+	std::atomic<std::chrono::steady_clock::time_point> start; //moved on by ponderhit, so written while the search reads it
+	std::atomic<bool> stop{ false };
+	std::atomic<bool> stopRequested{ false }; //ends the search at the next check once it has a move to play
+	std::atomic<bool> pondering{ false }; //searching on the opponent's time, so the clock is not watched until the move is played
+	std::vector<std::unique_ptr<SearchThread>> threads;
+	HashTable* table = &hashTable; //shared by the threads; searches that must not see each other's results each have their own
+};
+void move(const SearchLimits& limits); //iterative deepening search, plays the chosen move on the board
+void playSearch(); //plays one of the moves mainSearch chose, or announces the end of the game
+void startPondering(const SearchLimits& limits); //searches the human's expected reply in the background while they think
+bool stopPondering(Move humanMove); //true if the human played the expected reply, whose search then finishes as mainSearch
+void search(SearchContext& context, const Position& pos, const SearchLimits& limits); //fills context.threads[0]->chosenMoves
+void iterativeDeepening(SearchThread& thread);
+int searchRoot(SearchThread& thread, int depth, int alpha, int beta);
+int maxEvaluation(SearchThread& thread, int depth, int ply, int alpha, int beta); //minimax evaluation with alpha-beta bounds
+int quiescence(SearchThread& thread, int ply, int alpha, int beta); //captures only, so the horizon falls on a quiet position
+void orderHashMove(MoveList& log, Move move);
+void orderCaptures(const Position& pos, MoveList& log); //most valuable victim first, then least valuable attacker
+void orderMoves(const SearchThread& thread, MoveList& log, Move hashMove, int ply); //hash move, winning captures, killers, counter move, quiet moves by history, losing captures
+void updateHistory(SearchThread& thread, Move move, int ply, int depth, const Move* quiets, int quietCount); //rewards the quiet move that gave a cutoff and penalises those tried before it
+void initReductions();
+bool parseSelectivity(const std::string& text, int& selectivity); //"all", "none" or techniques such as "nmp,lmr"
+void orderRootMoves(MoveList& log, int* scores);
+long long elapsedTime(const SearchContext& context);
+long long totalNodes(const SearchContext& context); //main search and quiescence nodes together
+long long totalQNodes(const SearchContext& context);
+void checkLimits(SearchContext& context);
+void printStats(const SearchContext& context, std::ostream& out);
+std::string statsJson(const SearchContext& context); //one line of JSON for the search just finished
+int difficultyTime(int level);
+void smpBenchmark(int maxThreads, int moveTime);
+SearchLimits limits; //budget for each AI move
+SearchContext mainSearch; //the search of the game being played, or of the UCI front end
+SearchContext ponderSearch; //the search of the position after the human's expected reply
+std::thread ponderWorker;
+Move ponderMove = NO_MOVE; //the reply being pondered on
+bool PONDER = true; //think on the human's time in the game menu
+thread_local long long threadAllocations = 0; //heap allocations made by this thread, counted by operator new
+int THREADS = 1;
+bool SHOW_STATS = false; //print the search statistics after every AI move
+std::string STATS_FILE; //where every search appends its statistics as a line of JSON, none if empty
+std::mutex statsOutput;
+const int MATE_EVAL = 30000; //less the plies to mate, so that quicker mates score higher
+const int MATE_BOUND = MATE_EVAL - MAX_PLY; //evaluations beyond this are mates
+const int INFINITE_EVAL = 32000; //wider than any reachable evaluation
+const int ASPIRATION_WINDOW = 25; //initial half-width of the root window, in centipawns
+const int DELTA_MARGIN = 200; //captures that cannot raise alpha even with this much to spare are not searched
+const int HISTORY_MAX = 16384; //history scores stay within this either side of zero
+const int NULL_MOVE_DEPTH = 3; //shallowest depth to try a null move at
+const int NULL_VERIFY_DEPTH = 12; //null move cutoffs from this depth are confirmed by a reduced search without them
+const int LMR_DEPTH = 3; //shallowest depth to reduce late moves at
+const int LMR_MOVES = 3; //moves searched at full depth before the rest are reduced
+const int REVERSE_FUTILITY_DEPTH = 6;
+const int REVERSE_FUTILITY_MARGIN = 80; //per ply of depth left
+const int FUTILITY_DEPTH = 3;
+const int FUTILITY_MARGIN = 120; //per ply of depth left
+const int RAZOR_DEPTH = 2;
+const int RAZOR_MARGIN = 300; //per ply of depth left
+int lateReductions[64][64]; //plies to reduce by, by depth and move number
+int scoreToHash(int score, int ply);
+int scoreFromHash(int score, int ply);
+
+//perft utilities
+struct PerftPosition
+{
+	const char* name;
+	const char* fen;
+	long long expected[6]; //leaf counts at depths 1-6, 0 where unknown
+};
+long long perft(Position& pos, int depth);
+void perftDivide(const Position& pos, int depth, std::vector<long long>& counts, MoveList& rootLog);
+void perftCommand(int depth, const std::string& fen);
+void perftSuite(int depth);
+std::unique_ptr<HashSlot[]> perftTable; //leaf counts by position and depth, empty when disabled
+size_t perftSlots;
+int PERFT_HASH_MB = 0;
+const PerftPosition perftPositions[] = {
+	{ "start", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", { 20, 400, 8902, 197281, 4865609, 119060324 } },
+	{ "kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", { 48, 2039, 97862, 4085603, 193690690, 8031647685 } },
+	{ "endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", { 14, 191, 2812, 43238, 674624, 11030083 } },
+	{ "promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", { 6, 264, 9467, 422333, 15833292, 706045033 } },
+	{ "talkchess", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", { 44, 1486, 62379, 2103487, 89941194, 0 } },
+	{ "middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", { 46, 2079, 89890, 3894594, 164075551, 6923051137 } }
+};
+
+//bench utilities
+void benchCommand(int depth); //searches every bench position to the depth, printing the node count as a signature of the search
+void microBenchmark(); //times move generation, check detection, evaluation and make/unmake on their own
+const int BENCH_DEPTH = 5;
+const char* const benchPositions[] = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+	"4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+	"r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+	"r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+	"r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+	"4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+	"2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+	"r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+	"3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+	"r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+	"4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+	"3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+	"6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+	"3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+	"8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+	"7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+	"8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+	"8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+	"8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+	"8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+	"5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+	"6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+	"1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+	"6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+	"8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+	"5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+	"4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+	"r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+	"3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+	"4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+	"8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+	"8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+	"8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+	"8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+	"8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1",
+	"8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+	"8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+	"6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+	"r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+	"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+	"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+	"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+	"r1bqkbnr/pppp1ppp/2n5/1B2p3/4P3/5N2/PPPP1PPP/RNBQK2R b KQkq - 3 3",
+	"rnbqkb1r/pp3ppp/4pn2/2pp4/2PP4/2N2N2/PP2PPPP/R1BQKB1R w KQkq - 0 5",
+	"r1bqk2r/pp1nbppp/2p1pn2/3p4/2PP4/2N1PN2/PPQ2PPP/R1B1KB1R w KQkq - 2 7",
+	"2r2rk1/pp1bqppp/2n1pn2/3p4/2PP4/P1NBPN2/1P3PPP/2RQ1RK1 w - - 3 13",
+	"8/8/8/8/8/6k1/6p1/6K1 w - - 0 1",
+	"7k/7P/6K1/8/3B4/8/8/8 b - - 0 1"
+};
+
+//self-play utilities
+struct GameRecord
+{
+	std::string pgn;
+	int result; //1 when white won, -1 when black won, 0 for a draw
+	std::string termination;
+	int firstSide; //colour the first player had
+	long long nodes[2]; //searched by each player, the first player's first
+	long long time[2]; //milliseconds
+	int moves[2];
+};
+bool parsePlayer(const std::string& text, SearchLimits& limits); //"depth=6", "time=100" or "nodes=50000", joined by commas
+std::string playerName(const SearchLimits& limits);
+bool insufficientMaterial(const Position& pos);
+GameRecord playGame(SearchContext* contexts, const std::string& opening, const SearchLimits* players, int firstSide, int round, Key seed); //a search for each player, each with its own table
+void selfPlay(int games, int concurrency, const SearchLimits* players, const std::string& openingsFile, const std::string& pgnFile);
+const int MAX_GAME_PLIES = 600; //longer games are adjudicated drawn
+const char* const selfPlayOpenings[] = {
+	"e2e4 e7e5 g1f3 b8c6 f1b5 a7a6",
+	"e2e4 e7e5 g1f3 b8c6 f1c4 f8c5",
+	"e2e4 e7e5 g1f3 g8f6 f3e5 d7d6",
+	"e2e4 e7e5 f2f4 e5f4 g1f3 g7g5",
+	"e2e4 e7e5 b1c3 g8f6 f2f4 d7d5",
+	"e2e4 c7c5 g1f3 d7d6 d2d4 c5d4",
+	"e2e4 c7c5 b1c3 b8c6 g2g3 g7g6",
+	"e2e4 e7e6 d2d4 d7d5 b1c3 g8f6",
+	"e2e4 c7c6 d2d4 d7d5 e4e5 c8f5",
+	"e2e4 d7d5 e4d5 d8d5 b1c3 d5a5",
+	"e2e4 g8f6 e4e5 f6d5 d2d4 d7d6",
+	"e2e4 d7d6 d2d4 g8f6 b1c3 g7g6",
+	"d2d4 d7d5 c2c4 e7e6 b1c3 g8f6",
+	"d2d4 d7d5 c2c4 d5c4 g1f3 g8f6",
+	"d2d4 d7d5 c2c4 c7c6 g1f3 g8f6",
+	"d2d4 g8f6 c2c4 g7g6 b1c3 f8g7",
+	"d2d4 g8f6 c2c4 e7e6 b1c3 f8b4",
+	"d2d4 g8f6 c2c4 e7e6 g1f3 b7b6",
+	"d2d4 g8f6 c2c4 c7c5 d4d5 b7b5",
+	"d2d4 f7f5 g2g3 g8f6 f1g2 g7g6",
+	"d2d4 g8f6 c1g5 e7e6 e2e4 h7h6",
+	"c2c4 e7e5 b1c3 g8f6 g1f3 b8c6",
+	"c2c4 c7c5 g1f3 g8f6 b1c3 b8c6",
+	"g1f3 d7d5 g2g3 g8f6 f1g2 c7c6"
+};
+
+//test suite utilities
+struct EpdPosition
+{
+	Position pos;
+	MoveList best; //"bm", moves that solve the position
+	MoveList avoid; //"am", moves that do not
+	std::string id;
+};
+bool parseEpd(const std::string& line, EpdPosition& epd); //false unless the line holds a position with moves to find or avoid
+bool epdSolved(const EpdPosition& epd, Move move);
+void epdCommand(const std::string& path, int moveTime, int concurrency); //streams the file through a pool of searches, reporting each position as it finishes
+
+//book utilities
+const unsigned char* mapFile(const std::string& path, size_t& size); //read-only into memory, nullptr if it cannot be
+void unmapFile(const unsigned char* data, size_t size);
+bool openBook(const std::string& path); //maps a polyglot book into memory, replacing any open one
+void closeBook();
+Key polyglotKey(const Position& pos); //the key polyglot books are sorted by, which is not the search's own
+Move probeBook(Position& pos); //a move from the book picked in proportion to its weight, NO_MOVE when out of book
+void bookCommand(const std::string& fen); //lists the book's moves for the position and times the probe
+const unsigned char* bookData = nullptr; //sixteen bytes an entry: key, move, weight and learning data, all big-endian, sorted by key
+size_t bookEntries = 0;
+size_t bookSize = 0; //bytes mapped
+int BOOK_DEPTH = 20; //plies from the start of the game the book is followed for
+const int polyglotTypes[7] = { 0, 0, 3, 1, 2, 4, 5 }; //our piece types in polyglot's pawn, knight, bishop, rook, queen, king order
+const int polyglotPromotions[5] = { 0, KNIGHT, BISHOP, ROOK, QUEEN };
+const Key polyglotRandoms[781] = {
+	//pieces, 64 squares each for black pawn, white pawn, black knight, white knight and so on to the white king
+	0x9D39247E33776D41ULL, 0x2AF7398005AAA5C7ULL, 0x44DB015024623547ULL, 0x9C15F73E62A76AE2ULL,
+	0x75834465489C0C89ULL, 0x3290AC3A203001BFULL, 0x0FBBAD1F61042279ULL, 0xE83A908FF2FB60CAULL,
+	0x0D7E765D58755C10ULL, 0x1A083822CEAFE02DULL, 0x9605D5F0E25EC3B0ULL, 0xD021FF5CD13A2ED5ULL,
+	0x40BDF15D4A672E32ULL, 0x011355146FD56395ULL, 0x5DB4832046F3D9E5ULL, 0x239F8B2D7FF719CCULL,
+	0x05D1A1AE85B49AA1ULL, 0x679F848F6E8FC971ULL, 0x7449BBFF801FED0BULL, 0x7D11CDB1C3B7ADF0ULL,
+	0x82C7709E781EB7CCULL, 0xF3218F1C9510786CULL, 0x331478F3AF51BBE6ULL, 0x4BB38DE5E7219443ULL,
+	0xAA649C6EBCFD50FCULL, 0x8DBD98A352AFD40BULL, 0x87D2074B81D79217ULL, 0x19F3C751D3E92AE1ULL,
+	0xB4AB30F062B19ABFULL, 0x7B0500AC42047AC4ULL, 0xC9452CA81A09D85DULL, 0x24AA6C514DA27500ULL,
+	0x4C9F34427501B447ULL, 0x14A68FD73C910841ULL, 0xA71B9B83461CBD93ULL, 0x03488B95B0F1850FULL,
+	0x637B2B34FF93C040ULL, 0x09D1BC9A3DD90A94ULL, 0x3575668334A1DD3BULL, 0x735E2B97A4C45A23ULL,
+	0x18727070F1BD400BULL, 0x1FCBACD259BF02E7ULL, 0xD310A7C2CE9B6555ULL, 0xBF983FE0FE5D8244ULL,
+	0x9F74D14F7454A824ULL, 0x51EBDC4AB9BA3035ULL, 0x5C82C505DB9AB0FAULL, 0xFCF7FE8A3430B241ULL,
+	0x3253A729B9BA3DDEULL, 0x8C74C368081B3075ULL, 0xB9BC6C87167C33E7ULL, 0x7EF48F2B83024E20ULL,
+	0x11D505D4C351BD7FULL, 0x6568FCA92C76A243ULL, 0x4DE0B0F40F32A7B8ULL, 0x96D693460CC37E5DULL,
+	0x42E240CB63689F2FULL, 0x6D2BDCDAE2919661ULL, 0x42880B0236E4D951ULL, 0x5F0F4A5898171BB6ULL,
+	0x39F890F579F92F88ULL, 0x93C5B5F47356388BULL, 0x63DC359D8D231B78ULL, 0xEC16CA8AEA98AD76ULL,
+	0x5355F900C2A82DC7ULL, 0x07FB9F855A997142ULL, 0x5093417AA8A7ED5EULL, 0x7BCBC38DA25A7F3CULL,
+	0x19FC8A768CF4B6D4ULL, 0x637A7780DECFC0D9ULL, 0x8249A47AEE0E41F7ULL, 0x79AD695501E7D1E8ULL,
+	0x14ACBAF4777D5776ULL, 0xF145B6BECCDEA195ULL, 0xDABF2AC8201752FCULL, 0x24C3C94DF9C8D3F6ULL,
+	0xBB6E2924F03912EAULL, 0x0CE26C0B95C980D9ULL, 0xA49CD132BFBF7CC4ULL, 0xE99D662AF4243939ULL,
+	0x27E6AD7891165C3FULL, 0x8535F040B9744FF1ULL, 0x54B3F4FA5F40D873ULL, 0x72B12C32127FED2BULL,
+	0xEE954D3C7B411F47ULL, 0x9A85AC909A24EAA1ULL, 0x70AC4CD9F04F21F5ULL, 0xF9B89D3E99A075C2ULL,
+	0x87B3E2B2B5C907B1ULL, 0xA366E5B8C54F48B8ULL, 0xAE4A9346CC3F7CF2ULL, 0x1920C04D47267BBDULL,
+	0x87BF02C6B49E2AE9ULL, 0x092237AC237F3859ULL, 0xFF07F64EF8ED14D0ULL, 0x8DE8DCA9F03CC54EULL,
+	0x9C1633264DB49C89ULL, 0xB3F22C3D0B0B38EDULL, 0x390E5FB44D01144BULL, 0x5BFEA5B4712768E9ULL,
+	0x1E1032911FA78984ULL, 0x9A74ACB964E78CB3ULL, 0x4F80F7A035DAFB04ULL, 0x6304D09A0B3738C4ULL,
+	0x2171E64683023A08ULL, 0x5B9B63EB9CEFF80CULL, 0x506AACF489889342ULL, 0x1881AFC9A3A701D6ULL,
+	0x6503080440750644ULL, 0xDFD395339CDBF4A7ULL, 0xEF927DBCF00C20F2ULL, 0x7B32F7D1E03680ECULL,
+	0xB9FD7620E7316243ULL, 0x05A7E8A57DB91B77ULL, 0xB5889C6E15630A75ULL, 0x4A750A09CE9573F7ULL,
+	0xCF464CEC899A2F8AULL, 0xF538639CE705B824ULL, 0x3C79A0FF5580EF7FULL, 0xEDE6C87F8477609DULL,
+	0x799E81F05BC93F31ULL, 0x86536B8CF3428A8CULL, 0x97D7374C60087B73ULL, 0xA246637CFF328532ULL,
+	0x043FCAE60CC0EBA0ULL, 0x920E449535DD359EULL, 0x70EB093B15B290CCULL, 0x73A1921916591CBDULL,
+	0x56436C9FE1A1AA8DULL, 0xEFAC4B70633B8F81ULL, 0xBB215798D45DF7AFULL, 0x45F20042F24F1768ULL,
+	0x930F80F4E8EB7462ULL, 0xFF6712FFCFD75EA1ULL, 0xAE623FD67468AA70ULL, 0xDD2C5BC84BC8D8FCULL,
+	0x7EED120D54CF2DD9ULL, 0x22FE545401165F1CULL, 0xC91800E98FB99929ULL, 0x808BD68E6AC10365ULL,
+	0xDEC468145B7605F6ULL, 0x1BEDE3A3AEF53302ULL, 0x43539603D6C55602ULL, 0xAA969B5C691CCB7AULL,
+	0xA87832D392EFEE56ULL, 0x65942C7B3C7E11AEULL, 0xDED2D633CAD004F6ULL, 0x21F08570F420E565ULL,
+	0xB415938D7DA94E3CULL, 0x91B859E59ECB6350ULL, 0x10CFF333E0ED804AULL, 0x28AED140BE0BB7DDULL,
+	0xC5CC1D89724FA456ULL, 0x5648F680F11A2741ULL, 0x2D255069F0B7DAB3ULL, 0x9BC5A38EF729ABD4ULL,
+	0xEF2F054308F6A2BCULL, 0xAF2042F5CC5C2858ULL, 0x480412BAB7F5BE2AULL, 0xAEF3AF4A563DFE43ULL,
+	0x19AFE59AE451497FULL, 0x52593803DFF1E840ULL, 0xF4F076E65F2CE6F0ULL, 0x11379625747D5AF3ULL,
+	0xBCE5D2248682C115ULL, 0x9DA4243DE836994FULL, 0x066F70B33FE09017ULL, 0x4DC4DE189B671A1CULL,
+	0x51039AB7712457C3ULL, 0xC07A3F80C31FB4B4ULL, 0xB46EE9C5E64A6E7CULL, 0xB3819A42ABE61C87ULL,
+	0x21A007933A522A20ULL, 0x2DF16F761598AA4FULL, 0x763C4A1371B368FDULL, 0xF793C46702E086A0ULL,
+	0xD7288E012AEB8D31ULL, 0xDE336A2A4BC1C44BULL, 0x0BF692B38D079F23ULL, 0x2C604A7A177326B3ULL,
+	0x4850E73E03EB6064ULL, 0xCFC447F1E53C8E1BULL, 0xB05CA3F564268D99ULL, 0x9AE182C8BC9474E8ULL,
+	0xA4FC4BD4FC5558CAULL, 0xE755178D58FC4E76ULL, 0x69B97DB1A4C03DFEULL, 0xF9B5B7C4ACC67C96ULL,
+	0xFC6A82D64B8655FBULL, 0x9C684CB6C4D24417ULL, 0x8EC97D2917456ED0ULL, 0x6703DF9D2924E97EULL,
+	0xC547F57E42A7444EULL, 0x78E37644E7CAD29EULL, 0xFE9A44E9362F05FAULL, 0x08BD35CC38336615ULL,
+	0x9315E5EB3A129ACEULL, 0x94061B871E04DF75ULL, 0xDF1D9F9D784BA010ULL, 0x3BBA57B68871B59DULL,
+	0xD2B7ADEEDED1F73FULL, 0xF7A255D83BC373F8ULL, 0xD7F4F2448C0CEB81ULL, 0xD95BE88CD210FFA7ULL,
+	0x336F52F8FF4728E7ULL, 0xA74049DAC312AC71ULL, 0xA2F61BB6E437FDB5ULL, 0x4F2A5CB07F6A35B3ULL,
+	0x87D380BDA5BF7859ULL, 0x16B9F7E06C453A21ULL, 0x7BA2484C8A0FD54EULL, 0xF3A678CAD9A2E38CULL,
+	0x39B0BF7DDE437BA2ULL, 0xFCAF55C1BF8A4424ULL, 0x18FCF680573FA594ULL, 0x4C0563B89F495AC3ULL,
+	0x40E087931A00930DULL, 0x8CFFA9412EB642C1ULL, 0x68CA39053261169FULL, 0x7A1EE967D27579E2ULL,
+	0x9D1D60E5076F5B6FULL, 0x3810E399B6F65BA2ULL, 0x32095B6D4AB5F9B1ULL, 0x35CAB62109DD038AULL,
+	0xA90B24499FCFAFB1ULL, 0x77A225A07CC2C6BDULL, 0x513E5E634C70E331ULL, 0x4361C0CA3F692F12ULL,
+	0xD941ACA44B20A45BULL, 0x528F7C8602C5807BULL, 0x52AB92BEB9613989ULL, 0x9D1DFA2EFC557F73ULL,
+	0x722FF175F572C348ULL, 0x1D1260A51107FE97ULL, 0x7A249A57EC0C9BA2ULL, 0x04208FE9E8F7F2D6ULL,
+	0x5A110C6058B920A0ULL, 0x0CD9A497658A5698ULL, 0x56FD23C8F9715A4CULL, 0x284C847B9D887AAEULL,
+	0x04FEABFBBDB619CBULL, 0x742E1E651C60BA83ULL, 0x9A9632E65904AD3CULL, 0x881B82A13B51B9E2ULL,
+	0x506E6744CD974924ULL, 0xB0183DB56FFC6A79ULL, 0x0ED9B915C66ED37EULL, 0x5E11E86D5873D484ULL,
+	0xF678647E3519AC6EULL, 0x1B85D488D0F20CC5ULL, 0xDAB9FE6525D89021ULL, 0x0D151D86ADB73615ULL,
+	0xA865A54EDCC0F019ULL, 0x93C42566AEF98FFBULL, 0x99E7AFEABE000731ULL, 0x48CBFF086DDF285AULL,
+	0x7F9B6AF1EBF78BAFULL, 0x58627E1A149BBA21ULL, 0x2CD16E2ABD791E33ULL, 0xD363EFF5F0977996ULL,
+	0x0CE2A38C344A6EEDULL, 0x1A804AADB9CFA741ULL, 0x907F30421D78C5DEULL, 0x501F65EDB3034D07ULL,
+	0x37624AE5A48FA6E9ULL, 0x957BAF61700CFF4EULL, 0x3A6C27934E31188AULL, 0xD49503536ABCA345ULL,
+	0x088E049589C432E0ULL, 0xF943AEE7FEBF21B8ULL, 0x6C3B8E3E336139D3ULL, 0x364F6FFA464EE52EULL,
+	0xD60F6DCEDC314222ULL, 0x56963B0DCA418FC0ULL, 0x16F50EDF91E513AFULL, 0xEF1955914B609F93ULL,
+	0x565601C0364E3228ULL, 0xECB53939887E8175ULL, 0xBAC7A9A18531294BULL, 0xB344C470397BBA52ULL,
+	0x65D34954DAF3CEBDULL, 0xB4B81B3FA97511E2ULL, 0xB422061193D6F6A7ULL, 0x071582401C38434DULL,
+	0x7A13F18BBEDC4FF5ULL, 0xBC4097B116C524D2ULL, 0x59B97885E2F2EA28ULL, 0x99170A5DC3115544ULL,
+	0x6F423357E7C6A9F9ULL, 0x325928EE6E6F8794ULL, 0xD0E4366228B03343ULL, 0x565C31F7DE89EA27ULL,
+	0x30F5611484119414ULL, 0xD873DB391292ED4FULL, 0x7BD94E1D8E17DEBCULL, 0xC7D9F16864A76E94ULL,
+	0x947AE053EE56E63CULL, 0xC8C93882F9475F5FULL, 0x3A9BF55BA91F81CAULL, 0xD9A11FBB3D9808E4ULL,
+	0x0FD22063EDC29FCAULL, 0xB3F256D8ACA0B0B9ULL, 0xB03031A8B4516E84ULL, 0x35DD37D5871448AFULL,
+	0xE9F6082B05542E4EULL, 0xEBFAFA33D7254B59ULL, 0x9255ABB50D532280ULL, 0xB9AB4CE57F2D34F3ULL,
+	0x693501D628297551ULL, 0xC62C58F97DD949BFULL, 0xCD454F8F19C5126AULL, 0xBBE83F4ECC2BDECBULL,
+	0xDC842B7E2819E230ULL, 0xBA89142E007503B8ULL, 0xA3BC941D0A5061CBULL, 0xE9F6760E32CD8021ULL,
+	0x09C7E552BC76492FULL, 0x852F54934DA55CC9ULL, 0x8107FCCF064FCF56ULL, 0x098954D51FFF6580ULL,
+	0x23B70EDB1955C4BFULL, 0xC330DE426430F69DULL, 0x4715ED43E8A45C0AULL, 0xA8D7E4DAB780A08DULL,
+	0x0572B974F03CE0BBULL, 0xB57D2E985E1419C7ULL, 0xE8D9ECBE2CF3D73FULL, 0x2FE4B17170E59750ULL,
+	0x11317BA87905E790ULL, 0x7FBF21EC8A1F45ECULL, 0x1725CABFCB045B00ULL, 0x964E915CD5E2B207ULL,
+	0x3E2B8BCBF016D66DULL, 0xBE7444E39328A0ACULL, 0xF85B2B4FBCDE44B7ULL, 0x49353FEA39BA63B1ULL,
+	0x1DD01AAFCD53486AULL, 0x1FCA8A92FD719F85ULL, 0xFC7C95D827357AFAULL, 0x18A6A990C8B35EBDULL,
+	0xCCCB7005C6B9C28DULL, 0x3BDBB92C43B17F26ULL, 0xAA70B5B4F89695A2ULL, 0xE94C39A54A98307FULL,
+	0xB7A0B174CFF6F36EULL, 0xD4DBA84729AF48ADULL, 0x2E18BC1AD9704A68ULL, 0x2DE0966DAF2F8B1CULL,
+	0xB9C11D5B1E43A07EULL, 0x64972D68DEE33360ULL, 0x94628D38D0C20584ULL, 0xDBC0D2B6AB90A559ULL,
+	0xD2733C4335C6A72FULL, 0x7E75D99D94A70F4DULL, 0x6CED1983376FA72BULL, 0x97FCAACBF030BC24ULL,
+	0x7B77497B32503B12ULL, 0x8547EDDFB81CCB94ULL, 0x79999CDFF70902CBULL, 0xCFFE1939438E9B24ULL,
+	0x829626E3892D95D7ULL, 0x92FAE24291F2B3F1ULL, 0x63E22C147B9C3403ULL, 0xC678B6D860284A1CULL,
+	0x5873888850659AE7ULL, 0x0981DCD296A8736DULL, 0x9F65789A6509A440ULL, 0x9FF38FED72E9052FULL,
+	0xE479EE5B9930578CULL, 0xE7F28ECD2D49EECDULL, 0x56C074A581EA17FEULL, 0x5544F7D774B14AEFULL,
+	0x7B3F0195FC6F290FULL, 0x12153635B2C0CF57ULL, 0x7F5126DBBA5E0CA7ULL, 0x7A76956C3EAFB413ULL,
+	0x3D5774A11D31AB39ULL, 0x8A1B083821F40CB4ULL, 0x7B4A38E32537DF62ULL, 0x950113646D1D6E03ULL,
+	0x4DA8979A0041E8A9ULL, 0x3BC36E078F7515D7ULL, 0x5D0A12F27AD310D1ULL, 0x7F9D1A2E1EBE1327ULL,
+	0xDA3A361B1C5157B1ULL, 0xDCDD7D20903D0C25ULL, 0x36833336D068F707ULL, 0xCE68341F79893389ULL,
+	0xAB9090168DD05F34ULL, 0x43954B3252DC25E5ULL, 0xB438C2B67F98E5E9ULL, 0x10DCD78E3851A492ULL,
+	0xDBC27AB5447822BFULL, 0x9B3CDB65F82CA382ULL, 0xB67B7896167B4C84ULL, 0xBFCED1B0048EAC50ULL,
+	0xA9119B60369FFEBDULL, 0x1FFF7AC80904BF45ULL, 0xAC12FB171817EEE7ULL, 0xAF08DA9177DDA93DULL,
+	0x1B0CAB936E65C744ULL, 0xB559EB1D04E5E932ULL, 0xC37B45B3F8D6F2BAULL, 0xC3A9DC228CAAC9E9ULL,
+	0xF3B8B6675A6507FFULL, 0x9FC477DE4ED681DAULL, 0x67378D8ECCEF96CBULL, 0x6DD856D94D259236ULL,
+	0xA319CE15B0B4DB31ULL, 0x073973751F12DD5EULL, 0x8A8E849EB32781A5ULL, 0xE1925C71285279F5ULL,
+	0x74C04BF1790C0EFEULL, 0x4DDA48153C94938AULL, 0x9D266D6A1CC0542CULL, 0x7440FB816508C4FEULL,
+	0x13328503DF48229FULL, 0xD6BF7BAEE43CAC40ULL, 0x4838D65F6EF6748FULL, 0x1E152328F3318DEAULL,
+	0x8F8419A348F296BFULL, 0x72C8834A5957B511ULL, 0xD7A023A73260B45CULL, 0x94EBC8ABCFB56DAEULL,
+	0x9FC10D0F989993E0ULL, 0xDE68A2355B93CAE6ULL, 0xA44CFE79AE538BBEULL, 0x9D1D84FCCE371425ULL,
+	0x51D2B1AB2DDFB636ULL, 0x2FD7E4B9E72CD38CULL, 0x65CA5B96B7552210ULL, 0xDD69A0D8AB3B546DULL,
+	0x604D51B25FBF70E2ULL, 0x73AA8A564FB7AC9EULL, 0x1A8C1E992B941148ULL, 0xAAC40A2703D9BEA0ULL,
+	0x764DBEAE7FA4F3A6ULL, 0x1E99B96E70A9BE8BULL, 0x2C5E9DEB57EF4743ULL, 0x3A938FEE32D29981ULL,
+	0x26E6DB8FFDF5ADFEULL, 0x469356C504EC9F9DULL, 0xC8763C5B08D1908CULL, 0x3F6C6AF859D80055ULL,
+	0x7F7CC39420A3A545ULL, 0x9BFB227EBDF4C5CEULL, 0x89039D79D6FC5C5CULL, 0x8FE88B57305E2AB6ULL,
+	0xA09E8C8C35AB96DEULL, 0xFA7E393983325753ULL, 0xD6B6D0ECC617C699ULL, 0xDFEA21EA9E7557E3ULL,
+	0xB67C1FA481680AF8ULL, 0xCA1E3785A9E724E5ULL, 0x1CFC8BED0D681639ULL, 0xD18D8549D140CAEAULL,
+	0x4ED0FE7E9DC91335ULL, 0xE4DBF0634473F5D2ULL, 0x1761F93A44D5AEFEULL, 0x53898E4C3910DA55ULL,
+	0x734DE8181F6EC39AULL, 0x2680B122BAA28D97ULL, 0x298AF231C85BAFABULL, 0x7983EED3740847D5ULL,
+	0x66C1A2A1A60CD889ULL, 0x9E17E49642A3E4C1ULL, 0xEDB454E7BADC0805ULL, 0x50B704CAB602C329ULL,
+	0x4CC317FB9CDDD023ULL, 0x66B4835D9EAFEA22ULL, 0x219B97E26FFC81BDULL, 0x261E4E4C0A333A9DULL,
+	0x1FE2CCA76517DB90ULL, 0xD7504DFA8816EDBBULL, 0xB9571FA04DC089C8ULL, 0x1DDC0325259B27DEULL,
+	0xCF3F4688801EB9AAULL, 0xF4F5D05C10CAB243ULL, 0x38B6525C21A42B0EULL, 0x36F60E2BA4FA6800ULL,
+	0xEB3593803173E0CEULL, 0x9C4CD6257C5A3603ULL, 0xAF0C317D32ADAA8AULL, 0x258E5A80C7204C4BULL,
+	0x8B889D624D44885DULL, 0xF4D14597E660F855ULL, 0xD4347F66EC8941C3ULL, 0xE699ED85B0DFB40DULL,
+	0x2472F6207C2D0484ULL, 0xC2A1E7B5B459AEB5ULL, 0xAB4F6451CC1D45ECULL, 0x63767572AE3D6174ULL,
+	0xA59E0BD101731A28ULL, 0x116D0016CB948F09ULL, 0x2CF9C8CA052F6E9FULL, 0x0B090A7560A968E3ULL,
+	0xABEEDDB2DDE06FF1ULL, 0x58EFC10B06A2068DULL, 0xC6E57A78FBD986E0ULL, 0x2EAB8CA63CE802D7ULL,
+	0x14A195640116F336ULL, 0x7C0828DD624EC390ULL, 0xD74BBE77E6116AC7ULL, 0x804456AF10F5FB53ULL,
+	0xEBE9EA2ADF4321C7ULL, 0x03219A39EE587A30ULL, 0x49787FEF17AF9924ULL, 0xA1E9300CD8520548ULL,
+	0x5B45E522E4B1B4EFULL, 0xB49C3B3995091A36ULL, 0xD4490AD526F14431ULL, 0x12A8F216AF9418C2ULL,
+	0x001F837CC7350524ULL, 0x1877B51E57A764D5ULL, 0xA2853B80F17F58EEULL, 0x993E1DE72D36D310ULL,
+	0xB3598080CE64A656ULL, 0x252F59CF0D9F04BBULL, 0xD23C8E176D113600ULL, 0x1BDA0492E7E4586EULL,
+	0x21E0BD5026C619BFULL, 0x3B097ADAF088F94EULL, 0x8D14DEDB30BE846EULL, 0xF95CFFA23AF5F6F4ULL,
+	0x3871700761B3F743ULL, 0xCA672B91E9E4FA16ULL, 0x64C8E531BFF53B55ULL, 0x241260ED4AD1E87DULL,
+	0x106C09B972D2E822ULL, 0x7FBA195410E5CA30ULL, 0x7884D9BC6CB569D8ULL, 0x0647DFEDCD894A29ULL,
+	0x63573FF03E224774ULL, 0x4FC8E9560F91B123ULL, 0x1DB956E450275779ULL, 0xB8D91274B9E9D4FBULL,
+	0xA2EBEE47E2FBFCE1ULL, 0xD9F1F30CCD97FB09ULL, 0xEFED53D75FD64E6BULL, 0x2E6D02C36017F67FULL,
+	0xA9AA4D20DB084E9BULL, 0xB64BE8D8B25396C1ULL, 0x70CB6AF7C2D5BCF0ULL, 0x98F076A4F7A2322EULL,
+	0xBF84470805E69B5FULL, 0x94C3251F06F90CF3ULL, 0x3E003E616A6591E9ULL, 0xB925A6CD0421AFF3ULL,
+	0x61BDD1307C66E300ULL, 0xBF8D5108E27E0D48ULL, 0x240AB57A8B888B20ULL, 0xFC87614BAF287E07ULL,
+	0xEF02CDD06FFDB432ULL, 0xA1082C0466DF6C0AULL, 0x8215E577001332C8ULL, 0xD39BB9C3A48DB6CFULL,
+	0x2738259634305C14ULL, 0x61CF4F94C97DF93DULL, 0x1B6BACA2AE4E125BULL, 0x758F450C88572E0BULL,
+	0x959F587D507A8359ULL, 0xB063E962E045F54DULL, 0x60E8ED72C0DFF5D1ULL, 0x7B64978555326F9FULL,
+	0xFD080D236DA814BAULL, 0x8C90FD9B083F4558ULL, 0x106F72FE81E2C590ULL, 0x7976033A39F7D952ULL,
+	0xA4EC0132764CA04BULL, 0x733EA705FAE4FA77ULL, 0xB4D8F77BC3E56167ULL, 0x9E21F4F903B33FD9ULL,
+	0x9D765E419FB69F6DULL, 0xD30C088BA61EA5EFULL, 0x5D94337FBFAF7F5BULL, 0x1A4E4822EB4D7A59ULL,
+	0x6FFE73E81B637FB3ULL, 0xDDF957BC36D8B9CAULL, 0x64D0E29EEA8838B3ULL, 0x08DD9BDFD96B9F63ULL,
+	0x087E79E5A57D1D13ULL, 0xE328E230E3E2B3FBULL, 0x1C2559E30F0946BEULL, 0x720BF5F26F4D2EAAULL,
+	0xB0774D261CC609DBULL, 0x443F64EC5A371195ULL, 0x4112CF68649A260EULL, 0xD813F2FAB7F5C5CAULL,
+	0x660D3257380841EEULL, 0x59AC2C7873F910A3ULL, 0xE846963877671A17ULL, 0x93B633ABFA3469F8ULL,
+	0xC0C0F5A60EF4CDCFULL, 0xCAF21ECD4377B28CULL, 0x57277707199B8175ULL, 0x506C11B9D90E8B1DULL,
+	0xD83CC2687A19255FULL, 0x4A29C6465A314CD1ULL, 0xED2DF21216235097ULL, 0xB5635C95FF7296E2ULL,
+	0x22AF003AB672E811ULL, 0x52E762596BF68235ULL, 0x9AEBA33AC6ECC6B0ULL, 0x944F6DE09134DFB6ULL,
+	0x6C47BEC883A7DE39ULL, 0x6AD047C430A12104ULL, 0xA5B1CFDBA0AB4067ULL, 0x7C45D833AFF07862ULL,
+	0x5092EF950A16DA0BULL, 0x9338E69C052B8E7BULL, 0x455A4B4CFE30E3F5ULL, 0x6B02E63195AD0CF8ULL,
+	0x6B17B224BAD6BF27ULL, 0xD1E0CCD25BB9C169ULL, 0xDE0C89A556B9AE70ULL, 0x50065E535A213CF6ULL,
+	0x9C1169FA2777B874ULL, 0x78EDEFD694AF1EEDULL, 0x6DC93D9526A50E68ULL, 0xEE97F453F06791EDULL,
+	0x32AB0EDB696703D3ULL, 0x3A6853C7E70757A7ULL, 0x31865CED6120F37DULL, 0x67FEF95D92607890ULL,
+	0x1F2B1D1F15F6DC9CULL, 0xB69E38A8965C6B65ULL, 0xAA9119FF184CCCF4ULL, 0xF43C732873F24C13ULL,
+	0xFB4A3D794A9A80D2ULL, 0x3550C2321FD6109CULL, 0x371F77E76BB8417EULL, 0x6BFA9AAE5EC05779ULL,
+	0xCD04F3FF001A4778ULL, 0xE3273522064480CAULL, 0x9F91508BFFCFC14AULL, 0x049A7F41061A9E60ULL,
+	0xFCB6BE43A9F2FE9BULL, 0x08DE8A1C7797DA9BULL, 0x8F9887E6078735A1ULL, 0xB5B4071DBFC73A66ULL,
+	0x230E343DFBA08D33ULL, 0x43ED7F5A0FAE657DULL, 0x3A88A0FBBCB05C63ULL, 0x21874B8B4D2DBC4FULL,
+	0x1BDEA12E35F6A8C9ULL, 0x53C065C6C8E63528ULL, 0xE34A1D250E7A8D6BULL, 0xD6B04D3B7651DD7EULL,
+	0x5E90277E7CB39E2DULL, 0x2C046F22062DC67DULL, 0xB10BB459132D0A26ULL, 0x3FA9DDFB67E2F199ULL,
+	0x0E09B88E1914F7AFULL, 0x10E8B35AF3EEAB37ULL, 0x9EEDECA8E272B933ULL, 0xD4C718BC4AE8AE5FULL,
+	0x81536D601170FC20ULL, 0x91B534F885818A06ULL, 0xEC8177F83F900978ULL, 0x190E714FADA5156EULL,
+	0xB592BF39B0364963ULL, 0x89C350C893AE7DC1ULL, 0xAC042E70F8B383F2ULL, 0xB49B52E587A1EE60ULL,
+	0xFB152FE3FF26DA89ULL, 0x3E666E6F69AE2C15ULL, 0x3B544EBE544C19F9ULL, 0xE805A1E290CF2456ULL,
+	0x24B33C9D7ED25117ULL, 0xE74733427B72F0C1ULL, 0x0A804D18B7097475ULL, 0x57E3306D881EDB4FULL,
+	0x4AE7D6A36EB5DBCBULL, 0x2D8D5432157064C8ULL, 0xD1E649DE1E7F268BULL, 0x8A328A1CEDFE552CULL,
+	0x07A3AEC79624C7DAULL, 0x84547DDC3E203C94ULL, 0x990A98FD5071D263ULL, 0x1A4FF12616EEFC89ULL,
+	0xF6F7FD1431714200ULL, 0x30C05B1BA332F41CULL, 0x8D2636B81555A786ULL, 0x46C9FEB55D120902ULL,
+	0xCCEC0A73B49C9921ULL, 0x4E9D2827355FC492ULL, 0x19EBB029435DCB0FULL, 0x4659D2B743848A2CULL,
+	0x963EF2C96B33BE31ULL, 0x74F85198B05A2E7DULL, 0x5A0F544DD2B1FB18ULL, 0x03727073C2E134B1ULL,
+	0xC7F6AA2DE59AEA61ULL, 0x352787BAA0D7C22FULL, 0x9853EAB63B5E0B35ULL, 0xABBDCDD7ED5C0860ULL,
+	0xCF05DAF5AC8D77B0ULL, 0x49CAD48CEBF4A71EULL, 0x7A4C10EC2158C4A6ULL, 0xD9E92AA246BF719EULL,
+	0x13AE978D09FE5557ULL, 0x730499AF921549FFULL, 0x4E4B705B92903BA4ULL, 0xFF577222C14F0A3AULL,
+	0x55B6344CF97AAFAEULL, 0xB862225B055B6960ULL, 0xCAC09AFBDDD2CDB4ULL, 0xDAF8E9829FE96B5FULL,
+	0xB5FDFC5D3132C498ULL, 0x310CB380DB6F7503ULL, 0xE87FBB46217A360EULL, 0x2102AE466EBB1148ULL,
+	0xF8549E1A3AA5E00DULL, 0x07A69AFDCC42261AULL, 0xC4C118BFE78FEAAEULL, 0xF9F4892ED96BD438ULL,
+	0x1AF3DBE25D8F45DAULL, 0xF5B4B0B0D2DEEEB4ULL, 0x962ACEEFA82E1C84ULL, 0x046E3ECAAF453CE9ULL,
+	0xF05D129681949A4CULL, 0x964781CE734B3C84ULL, 0x9C2ED44081CE5FBDULL, 0x522E23F3925E319EULL,
+	0x177E00F9FC32F791ULL, 0x2BC60A63A6F3B3F2ULL, 0x222BBFAE61725606ULL, 0x486289DDCC3D6780ULL,
+	0x7DC7785B8EFDFC80ULL, 0x8AF38731C02BA980ULL, 0x1FAB64EA29A2DDF7ULL, 0xE4D9429322CD065AULL,
+	0x9DA058C67844F20CULL, 0x24C0E332B70019B0ULL, 0x233003B5A6CFE6ADULL, 0xD586BD01C5C217F6ULL,
+	0x5E5637885F29BC2BULL, 0x7EBA726D8C94094BULL, 0x0A56A5F0BFE39272ULL, 0xD79476A84EE20D06ULL,
+	0x9E4C1269BAA4BF37ULL, 0x17EFEE45B0DEE640ULL, 0x1D95B0A5FCF90BC6ULL, 0x93CBE0B699C2585DULL,
+	0x65FA4F227A2B6D79ULL, 0xD5F9E858292504D5ULL, 0xC2B5A03F71471A6FULL, 0x59300222B4561E00ULL,
+	0xCE2F8642CA0712DCULL, 0x7CA9723FBB2E8988ULL, 0x2785338347F2BA08ULL, 0xC61BB3A141E50E8CULL,
+	0x150F361DAB9DEC26ULL, 0x9F6A419D382595F4ULL, 0x64A53DC924FE7AC9ULL, 0x142DE49FFF7A7C3DULL,
+	0x0C335248857FA9E7ULL, 0x0A9C32D5EAE45305ULL, 0xE6C42178C4BBB92EULL, 0x71F1CE2490D20B07ULL,
+	0xF1BCC3D275AFE51AULL, 0xE728E8C83C334074ULL, 0x96FBF83A12884624ULL, 0x81A1549FD6573DA5ULL,
+	0x5FA7867CAF35E149ULL, 0x56986E2EF3ED091BULL, 0x917F1DD5F8886C61ULL, 0xD20D8C88C8FFE65FULL,
+	//castling rights: white kingside, white queenside, black kingside, black queenside
+	0x31D71DCE64B2C310ULL, 0xF165B587DF898190ULL, 0xA57E6339DD2CF3A0ULL, 0x1EF6E6DBB1961EC9ULL,
+	//en passant file
+	0x70CC73D90BC26E24ULL, 0xE21A6B35DF0C3AD7ULL, 0x003A93D8B2806962ULL, 0x1C99DED33CB890A1ULL,
+	0xCF3145DE0ADD4289ULL, 0xD0E4427A5514FB72ULL, 0x77C621CC9FB3A483ULL, 0x67A34DAC4356550BULL,
+	//white to move
+	0xF8D626AAAF278509ULL
+};
 
-int main()
+//tablebase utilities
+struct Tablebase
 {
+	std::string name; //such as "KQvKR", white's pieces first
+	int pieces[4]; //piece code of each square the index numbers: the white king, the black king, then white's pieces and black's
+	int count; //pieces on the board, kings included
+	bool pawns; //without pawns the board is folded along both middle lines, with them only between the d and e files
+	Key material; //how many there are of each piece code, four bits apiece
+	Key mirrored; //the same with the colours swapped
+	size_t size; //positions: the side to move, the white king's square on the folded board, then the square of each other piece
+	const unsigned char* data; //a byte a position: 0 for a draw, otherwise one more than the plies to mate, odd when the side to move is mated
+	size_t mapped; //bytes of the file mapped
+};
+bool makeTablebase(const std::string& name, Tablebase& tb); //false unless the name is a material such as "KRvKP" of up to TABLEBASE_MEN pieces
+std::vector<std::string> tablebaseNames(); //every table of up to TABLEBASE_MEN pieces
+std::vector<std::string> tablebaseDependencies(const Tablebase& tb); //tables a capture or promotion leads to
+size_t tablebaseIndex(const Tablebase& tb, int side, const int* squares); //folds the board to put the white king in its lower left, then numbers the position
+void tablebaseSquares(const Tablebase& tb, size_t index, int& side, int* squares);
+int probeTablebase(const Position& pos); //the table's byte for the position, -1 when no table holds it
+int tablebaseScore(int value, int ply);
+bool probeRoot(Position& pos, MoveList& best, int& eval); //moves keeping the best distance to mate, false unless the tables hold every move
+int loadTablebases(const std::string& directory); //maps every table found there, returning how many
+void closeTablebases();
+bool generateTablebase(const std::string& name, const std::string& directory, int threads); //with every table it depends on, unless already on disk
+const int TABLEBASE_MEN = 4;
+std::vector<Tablebase> tablebases;
+int tablebaseMen = 0; //most pieces in any table loaded, 0 when there are none
+std::string TABLEBASE_PATH = "tablebases"; //where tables are generated and loaded from
+
+//uci utilities
+void uciLoop(std::string line); //reads commands from a GUI until "quit", starting with one already read, searching on a worker thread
+void uciPosition(std::istringstream& stream);
+void uciGo(std::istringstream& stream);
+void uciSetOption(std::istringstream& stream);
+void uciStop(); //ends any search in progress, which then reports its move
+void uciInfo(const SearchThread& thread, int depth, int eval);
+void uciSend(const std::string& line);
+void hashPv(const Position& root, Move first, int depth, MoveList& pv); //the first move and those the table holds after it
+int uciMoveTime(long long time, long long increment, int movesToGo);
+bool uciMode; //report each iteration to the GUI
+bool uciInvalid = false; //the last position sent could not be set up, so there is nothing to search until another is
+std::thread uciWorker;
+std::mutex uciOutput; //the reader, the search and the worker all write lines
+const int MOVE_OVERHEAD = 50; //milliseconds kept back for the GUI and the operating system
+
+int main(int argc, char* argv[])
+{
+	initAttacks();
+	initZobrist();
+	initEvaluation();
+	initReductions();
+	networkKernel = bestKernel();
+
+	//options take the following argument as their value; anything else is a command word
+	std::vector<std::string> command;
+	std::string networkFile;
+	std::string openingsFile;
+	std::string pgnFile = "selfplay.pgn";
+	std::string bookFile;
+	for (int k = 1; k < argc; k++)
+	{
+		std::string option = argv[k];
+
+		if (option.compare(0, 2, "--") != 0 || k + 1 >= argc)
+		{
+			command.push_back(option);
+			continue;
+		}
+
+		//the transposition table size can be given in megabytes with "--hash 64"
+		if (option == "--hash")
+		{
+			HASH_SIZE_MB = std::max(1, atoi(argv[++k]));
+		}
+		//"--nodes 100000" adds a node budget to each AI move
+		else if (option == "--nodes")
+		{
+			limits.nodes = atoll(argv[++k]);
+		}
+		//"--selective nmp,lmr" limits the selective search to the techniques listed: "nmp" null move pruning, "lmr"
+		//late move reductions, "rfp" reverse futility pruning, "fp" futility pruning and "razor" razoring, or "all" or "none"
+		else if (option == "--selective")
+		{
+			if (!parseSelectivity(argv[++k], SELECTIVITY))
+			{
+				std::cout << "Invalid selective search " << argv[k] << std::endl;
+				return 1;
+			}
+			limits.selectivity = SELECTIVITY;
+		}
+		//"--threads 8" searches with eight threads sharing the transposition table
+		else if (option == "--threads")
+		{
+			THREADS = std::max(1, atoi(argv[++k]));
+		}
+		//"--stats on" prints the search statistics after every AI move
+		else if (option == "--stats")
+		{
+			SHOW_STATS = std::string(argv[++k]) != "off";
+		}
+		//"--ponder off" leaves the AI idle while the human thinks
+		else if (option == "--ponder")
+		{
+			PONDER = std::string(argv[++k]) != "off";
+		}
+		//"--statsjson stats.jsonl" appends the statistics of every search to the file as a line of JSON
+		else if (option == "--statsjson")
+		{
+			STATS_FILE = argv[++k];
+		}
+		//"--perfthash 64" lets perft reuse the counts of transposed subtrees
+		else if (option == "--perfthash")
+		{
+			PERFT_HASH_MB = std::max(0, atoi(argv[++k]));
+		}
+		//"--nnue net.bin" evaluates with a network read from the file instead of the handcrafted terms
+		else if (option == "--nnue")
+		{
+			networkFile = argv[++k];
+		}
+		//"--openings book.txt" gives self-play a fen or a line of moves to start each game from
+		else if (option == "--openings")
+		{
+			openingsFile = argv[++k];
+		}
+		//"--pgn games.pgn" is where self-play writes its games
+		else if (option == "--pgn")
+		{
+			pgnFile = argv[++k];
+		}
+		//"--book book.bin" plays from a polyglot opening book while it has moves for the position
+		else if (option == "--book")
+		{
+			bookFile = argv[++k];
+		}
+		//"--bookdepth 16" stops following the book sixteen plies into the game
+		else if (option == "--bookdepth")
+		{
+			BOOK_DEPTH = std::max(0, atoi(argv[++k]));
+		}
+		//"--tbpath tables" is where endgame tables are generated and loaded from
+		else if (option == "--tbpath")
+		{
+			TABLEBASE_PATH = argv[++k];
+		}
+		//"--fen \"8/8/4k3/8/8/4K3/4P3/8 w - - 0 1\"" starts games in the menu from the position instead of the standard one
+		else if (option == "--fen")
+		{
+			START_FEN = argv[++k];
+		}
+		else
+		{
+			command.push_back(option);
+		}
+	}
+	resizeHash(hashTable, HASH_SIZE_MB);
+
+	Position given = Position();
+	if (!START_FEN.empty() && !setFen(given, START_FEN))
+	{
+		std::cout << "Invalid fen " << START_FEN << std::endl;
+		return 1;
+	}
+
+	if (!bookFile.empty() && !openBook(bookFile))
+	{
+		std::cout << "Could not open the book " << bookFile << std::endl;
+		return 1;
+	}
+
+	//"tbgen [tables] [threads]" generates endgame tables such as "KQvKR", or "all" of them, with those they depend on
+	if (!command.empty() && command[0] == "tbgen")
+	{
+		std::vector<std::string> names;
+		int threads = (int)std::max(1U, std::thread::hardware_concurrency());
+		for (int k = 1; k < (int)command.size(); k++)
+		{
+			if (command[k] == "all")
+			{
+				std::vector<std::string> all = tablebaseNames();
+				names.insert(names.end(), all.begin(), all.end());
+			}
+			else if (isdigit(command[k][0]))
+			{
+				threads = std::max(1, stoi(command[k]));
+			}
+			else
+			{
+				names.push_back(command[k]);
+			}
+		}
+		if (names.empty())
+		{
+			names = tablebaseNames();
+		}
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (const std::string& name : names)
+		{
+			if (!generateTablebase(name, TABLEBASE_PATH, threads))
+			{
+				std::cout << "Could not generate " << name << std::endl;
+				return 1;
+			}
+		}
+		long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		std::cout << tablebases.size() << " tables in " << TABLEBASE_PATH << ", " << std::fixed << std::setprecision(1) << elapsed / 1000.0 << " s" << std::endl;
+		return 0;
+	}
+	loadTablebases(TABLEBASE_PATH);
+
+	//"book [fen]" lists the book's moves for the position, the start position if none is given
+	if (!command.empty() && command[0] == "book")
+	{
+		std::string fen;
+		for (int k = 1; k < (int)command.size(); k++)
+		{
+			fen += (k > 1 ? " " : "") + command[k];
+		}
+		bookCommand(fen);
+		return 0;
+	}
+
+	//"evalbench [file]" times the handcrafted evaluation against the network with each kernel the processor has
+	if (!command.empty() && command[0] == "evalbench")
+	{
+		evalBenchmark(command.size() > 1 ? command[1] : networkFile);
+		return 0;
+	}
+
+	if (!networkFile.empty())
+	{
+		if (!loadNetwork(networkFile))
+		{
+			std::cout << "Could not load the network from " << networkFile << std::endl;
+			return 1;
+		}
+		useNetwork = true;
+	}
+
+	//"smpbench [threads] [ms]" measures how search speed scales with the number of threads
+	if (!command.empty() && command[0] == "smpbench")
+	{
+		int maxThreads = command.size() > 1 ? stoi(command[1]) : (int)std::max(1U, std::thread::hardware_concurrency());
+		int moveTime = command.size() > 2 ? stoi(command[2]) : 2000;
+		smpBenchmark(std::max(1, maxThreads), std::max(1, moveTime));
+		return 0;
+	}
+
+	//"uci" speaks the universal chess interface on stdin and stdout, as GUIs and match runners expect
+	if (!command.empty() && command[0] == "uci")
+	{
+		uciLoop("");
+		return 0;
+	}
+
+	//"selfplay [games] [concurrency] [first] [second]" plays games between two search budgets such as "depth=6" or
+	//"time=100,nodes=50000" alongside each other, writing them as PGN and printing a summary
+	if (!command.empty() && command[0] == "selfplay")
+	{
+		int games = command.size() > 1 ? stoi(command[1]) : 100;
+		int concurrency = command.size() > 2 ? stoi(command[2]) : (int)std::max(1U, std::thread::hardware_concurrency() / THREADS);
+		SearchLimits players[2];
+		for (int player = 0; player < 2; player++)
+		{
+			std::string text = (int)command.size() > 3 + player ? command[3 + player] : "time=100";
+			if (!parsePlayer(text, players[player]))
+			{
+				std::cout << "Invalid search budget " << text << std::endl;
+				return 1;
+			}
+		}
+		selfPlay(std::max(1, games), std::max(1, concurrency), players, openingsFile, pgnFile);
+		return 0;
+	}
+
+	//"bench [depth]" searches the bench positions to a fixed depth on one thread; the node count it prints changes
+	//only when the search does. "bench micro" times the move generator, check detection and evaluation on their own
+	if (!command.empty() && command[0] == "bench")
+	{
+		if (command.size() > 1 && command[1] == "micro")
+		{
+			microBenchmark();
+		}
+		else
+		{
+			benchCommand(std::max(1, command.size() > 1 ? stoi(command[1]) : BENCH_DEPTH));
+		}
+		return 0;
+	}
+
+	//"epd <file> [ms] [concurrency]" searches every position of a test suite for the time given (default a second),
+	//several at once, and checks the moves against the suite's "bm" and "am" operations
+	if (!command.empty() && command[0] == "epd")
+	{
+		if (command.size() < 2)
+		{
+			std::cout << "Usage: epd <file> [ms] [concurrency]" << std::endl;
+			return 1;
+		}
+		int moveTime = command.size() > 2 ? stoi(command[2]) : 1000;
+		int concurrency = command.size() > 3 ? stoi(command[3]) : (int)std::max(1U, std::thread::hardware_concurrency() / THREADS);
+		epdCommand(command[1], std::max(1, moveTime), std::max(1, concurrency));
+		return 0;
+	}
+
+	//"perft <depth> [fen]" counts the leaves of the move tree, either for the given position with
+	//a count for each move, or for each of the standard test positions
+	if (!command.empty() && command[0] == "perft")
+	{
+		int depth = command.size() > 1 ? stoi(command[1]) : 5;
+		std::string fen;
+		for (int k = 2; k < (int)command.size(); k++)
+		{
+			fen += (k > 2 ? " " : "") + command[k];
+		}
+
+		if (fen.empty())
+		{
+			perftSuite(std::max(1, depth));
+		}
+		else
+		{
+			perftCommand(std::max(1, depth), fen);
+		}
+		return 0;
+	}
+
 	std::cout << "Please select your game type:" << std::endl
 		<< "1) Human vs AI" << std::endl
 		<< "2) AI vs AI" << std::endl;
@@ -35,6 +1160,13 @@ int main()
 	std::string inputString;
 	std::cin >> inputString;
 
+	//a GUI starting the client sends "uci" rather than picking from the menu
+	if (inputString == "uci")
+	{
+		uciLoop(inputString);
+		return 0;
+	}
+
 	if (inputString == "1")
 	{
 		std::cout << "Please select your difficulty:" << std::endl
@@ -44,27 +1176,23 @@ int main()
 			<< "4+) HAL 9000 (expect large computation times)" << std::endl;
 
 		std::cin >> inputString;
-		MAX_DEPTH = stoi(inputString);
+		limits.moveTime = difficultyTime(stoi(inputString));
 
 		std::cout << "Enter your move in the form \"d2d4\":" << std::endl;
-		initBoard();
-		//initTestBoard();
-		drawBoard();
+		startGame(board);
+		drawBoard(board);
 
 		while (inputString != "quit")
 		{
 			std::cin >> inputString;
-			
-			int iFrom = inputString[0] - '0' - 49;
-			int jFrom = inputString[1] - '0' - 1;
-			int iTo = inputString[2] - '0' - 49;
-			int jTo = inputString[3] - '0' - 1;
 
-			//checks that the entry is in the required form
-			if (iFrom >= 0 && iFrom <= 7 && jFrom >= 0 && jFrom <= 7 && iTo >= 0 && iTo <= 7 && jTo >= 0 && jTo <= 7)
+			//checks that the entry is in the required form and is one of the available moves
+			Move humanMove = parseMove(board, inputString);
+
+			if (humanMove != NO_MOVE)
 			{
 				//in the case of promotion, allow the player to choose which piece they promote to
-				if (board[iFrom][jFrom] == 1 && jTo == 7)
+				if (promotionType(humanMove) != 0)
 				{
 					std::cout << "Promote to the following:" << std::endl
 						<< "1) Queen" << std::endl
@@ -74,56 +1202,66 @@ int main()
 
 					std::cin >> inputString;
 
+					std::string text = moveText(humanMove).substr(0, 4);
 					switch (stoi(inputString))
 					{
-						case 1: board[iTo][jTo] = 9;
+						case 1: text += 'q';
 							break;
-						case 2: board[iTo][jTo] = 5;
+						case 2: text += 'n';
 							break;
-						case 3: board[iTo][jTo] = 7;
+						case 3: text += 'b';
 							break;
-						case 4: board[iTo][jTo] = 3;
+						case 4: text += 'r';
 							break;
 					}
+					humanMove = parseMove(board, text);
+				}
+
+				//make the human move, ending the search of the reply the AI expected
+				bool ponderHit = stopPondering(humanMove);
+				Undo undo;
+				makeMove(board, humanMove, undo);
 
-					board[iFrom][jFrom] = 0;
-					moveCounter++;
+				//make the AI move, which the search already under way has been thinking about if the human
+				//played the expected reply
+				if (ponderHit)
+				{
+					playSearch();
 				}
 				else
 				{
-					//make the human move
-					board[iTo][jTo] = board[iFrom][jFrom];
-					board[iFrom][jFrom] = 0;
-					moveCounter++;
+					move(limits);
 				}
 
-				//make the AI move
-				flipBoard();
-				move(MAX_DEPTH);
-				flipBoard();
-
-				drawBoard();
+				drawBoard(board);
+				startPondering(limits);
 			}
 			else if (inputString == "reset")
 			{
 				//clear and reinitialise the board
-				for(int i = 0; i <= 7; i++)
-					for (int j = 0; j <= 7; j++)
-					{
-						board[i][j] = 0;
-					}
-
-				moveCounter = 0;
-
-				initBoard();
-				//initTestBoard();
-				drawBoard();
+				stopPondering(NO_MOVE);
+				clearHash(hashTable);
+				startGame(board);
+				drawBoard(board);
+			}
+			else if (inputString == "hash")
+			{
+				std::cout << "Hash: " << HASH_SIZE_MB << " MB, " << hashFull(hashTable) / 10.0 << "% full" << std::endl;
+			}
+			else if (inputString == "stats" && !mainSearch.threads.empty())
+			{
+				printStats(mainSearch, std::cout);
+			}
+			else if (inputString == "fen")
+			{
+				std::cout << fenText(board) << std::endl;
 			}
 			else if(inputString != "quit")
 			{
 				std::cout << "Invalid move." << std::endl;
 			}
 		}
+		stopPondering(NO_MOVE);
 	}
 	else if (inputString == "2")
 	{
@@ -134,12 +1272,11 @@ int main()
 			<< "4+) HAL 9000 (expect large computation times)" << std::endl;
 
 		std::cin >> inputString;
-		MAX_DEPTH = stoi(inputString);
+		limits.moveTime = difficultyTime(stoi(inputString));
 
 		std::cout << "Type any message to progress the game." << std::endl;
-		initBoard();
-		//initTestBoard();
-		drawBoard();
+		startGame(board);
+		drawBoard(board);
 
 		while (inputString != "quit")
 		{
@@ -147,32 +1284,27 @@ int main()
 
 			if (inputString == "reset")
 			{
-				for (int i = 0; i <= 7; i++)
-					for (int j = 0; j <= 7; j++)
-					{
-						board[i][j] = 0;
-					}
-
-				moveCounter = 0;
-
-				initBoard();
-				//initTestBoard();
-				drawBoard();
+				clearHash(hashTable);
+				startGame(board);
+				drawBoard(board);
+			}
+			else if (inputString == "hash")
+			{
+				std::cout << "Hash: " << HASH_SIZE_MB << " MB, " << hashFull(hashTable) / 10.0 << "% full" << std::endl;
+			}
+			else if (inputString == "stats" && !mainSearch.threads.empty())
+			{
+				printStats(mainSearch, std::cout);
+			}
+			else if (inputString == "fen")
+			{
+				std::cout << fenText(board) << std::endl;
 			}
 			else if (inputString != "quit")
 			{
-				if (moveCounter % 2 == 0)
-				{
-					move(MAX_DEPTH);
-				}
-				else
-				{
-					flipBoard();
-					move(MAX_DEPTH);
-					flipBoard();
-				}
+				move(limits);
 
-				drawBoard();
+				drawBoard(board);
 			}
 		}
 	}
@@ -180,1146 +1312,5063 @@ int main()
 	return 0;
 }
 
-void initBoard()
+int toSquare(int i, int j)
 {
-	for (int i = 0; i <= 7; i++)
-	{
-		//initialise pawns
-		board[i][1] = 1;
-		board[i][6] = 2;
-	}
-
-	//initialise rooks
-	board[0][0] = 3;
-	board[7][0] = 3;
-	board[0][7] = 4;
-	board[7][7] = 4;
-
-	//initialise knights
-	board[1][0] = 5;
-	board[6][0] = 5;
-	board[1][7] = 6;
-	board[6][7] = 6;
-
-	//initialise bishops
-	board[2][0] = 7;
-	board[5][0] = 7;
-	board[2][7] = 8;
-	board[5][7] = 8;
-
-	//initialise queens
-	board[3][0] = 9;
-	board[3][7] = 10;
-
-	//initialise kings
-	board[4][0] = 11;
-	board[4][7] = 12;
+	return i + 8 * j;
 }
 
-void initTestBoard()
+int popCount(Bitboard b)
 {
-	//move evaluation test
-	board[5][7] = 8;
-	board[4][6] = 6;
-	board[2][6] = 2;
-	board[3][5] = 7;
-	board[4][0] = 3;
-
-	/*
-	//promotion test
-	board[2][6] = 1;
-	board[3][5] = 1;
-	board[4][6] = 6;
-	board[7][6] = 4;
-	*/
+#if defined(_MSC_VER)
+	return (int)__popcnt64(b);
+#else
+	return __builtin_popcountll(b);
+#endif
 }
 
-void drawBoard()
+int lsb(Bitboard b)
 {
-	for (int j = 7; j >= 0; j--)
-	{
-		for (int i = 0; i <= 7; i++)
-		{
-			switch (board[i][j])
-			{
-				case 0: std::cout << "+";
-					break;
-				case 1: std::cout << "p";
-					break;
-				case 2: std::cout << "P";
-					break;
-				case 3: std::cout << "r";
-					break;
-				case 4: std::cout << "R";
-					break;
-				case 5: std::cout << "n";
-					break;
-				case 6: std::cout << "N";
-					break;
-				case 7: std::cout << "b";
-					break;
-				case 8: std::cout << "B";
-					break;
-				case 9: std::cout << "q";
-					break;
-				case 10: std::cout << "Q";
-					break;
-				case 11: std::cout << "k";
-					break;
-				case 12: std::cout << "K";
-					break;
-			}
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward64(&index, b);
+	return (int)index;
+#else
+	return __builtin_ctzll(b);
+#endif
+}
 
-			std::cout << " ";
-		}
+int msb(Bitboard b)
+{
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanReverse64(&index, b);
+	return (int)index;
+#else
+	return 63 - __builtin_clzll(b);
+#endif
+}
 
-		std::cout << std::endl;
-	}
+int popLsb(Bitboard& b)
+{
+	int square = lsb(b);
+	b &= b - 1;
+	return square;
 }
 
-void flipBoard() //allows us to take advantage of black/white symmetry
+void initAttacks()
 {
+	const int knightSteps[8][2] = { { 1, 2 }, { 2, 1 }, { 2, -1 }, { 1, -2 }, { -1, -2 }, { -2, -1 }, { -2, 1 }, { -1, 2 } };
+	const int kingSteps[8][2] = { { 0, 1 }, { 1, 1 }, { 1, 0 }, { 1, -1 }, { 0, -1 }, { -1, -1 }, { -1, 0 }, { -1, 1 } };
+	//directions 0-3 increase the square index, 4-7 are their opposites
+	const int raySteps[8][2] = { { 0, 1 }, { 1, 0 }, { 1, 1 }, { -1, 1 }, { 0, -1 }, { -1, 0 }, { -1, -1 }, { 1, -1 } };
+
 	for (int i = 0; i <= 7; i++)
 		for (int j = 0; j <= 7; j++)
 		{
-			switch (board[i][j])
+			int square = toSquare(i, j);
+
+			knightAttacks[square] = 0;
+			kingAttacks[square] = 0;
+			for (int k = 0; k < 8; k++)
 			{
-			case 1: board[i][j] = 2;
-				break;
-			case 2: board[i][j] = 1;
-				break;
-			case 3: board[i][j] = 4;
-				break;
-			case 4: board[i][j] = 3;
-				break;
-			case 5: board[i][j] = 6;
-				break;
-			case 6: board[i][j] = 5;
-				break;
-			case 7: board[i][j] = 8;
-				break;
-			case 8: board[i][j] = 7;
-				break;
-			case 9: board[i][j] = 10;
-				break;
-			case 10: board[i][j] = 9;
-				break;
-			case 11: board[i][j] = 12;
-				break;
-			case 12: board[i][j] = 11;
-				break;
+				int ki = i + knightSteps[k][0];
+				int kj = j + knightSteps[k][1];
+				if (ki >= 0 && ki <= 7 && kj >= 0 && kj <= 7)
+				{
+					knightAttacks[square] |= 1ULL << toSquare(ki, kj);
+				}
+
+				ki = i + kingSteps[k][0];
+				kj = j + kingSteps[k][1];
+				if (ki >= 0 && ki <= 7 && kj >= 0 && kj <= 7)
+				{
+					kingAttacks[square] |= 1ULL << toSquare(ki, kj);
+				}
+			}
+
+			pawnAttacks[0][square] = 0;
+			pawnAttacks[1][square] = 0;
+			if (j + 1 <= 7)
+			{
+				if (i - 1 >= 0)
+				{
+					pawnAttacks[0][square] |= 1ULL << toSquare(i - 1, j + 1);
+				}
+				if (i + 1 <= 7)
+				{
+					pawnAttacks[0][square] |= 1ULL << toSquare(i + 1, j + 1);
+				}
+			}
+			if (j - 1 >= 0)
+			{
+				if (i - 1 >= 0)
+				{
+					pawnAttacks[1][square] |= 1ULL << toSquare(i - 1, j - 1);
+				}
+				if (i + 1 <= 7)
+				{
+					pawnAttacks[1][square] |= 1ULL << toSquare(i + 1, j - 1);
+				}
+			}
+
+			//a king or rook leaving its starting square, or a rook being captured there, loses the rights
+			castlingMask[square] = 15;
+			if (square == toSquare(4, 0))
+			{
+				castlingMask[square] &= ~(WHITE_KINGSIDE | WHITE_QUEENSIDE);
+			}
+			if (square == toSquare(4, 7))
+			{
+				castlingMask[square] &= ~(BLACK_KINGSIDE | BLACK_QUEENSIDE);
+			}
+			if (square == toSquare(7, 0))
+			{
+				castlingMask[square] &= ~WHITE_KINGSIDE;
+			}
+			if (square == toSquare(0, 0))
+			{
+				castlingMask[square] &= ~WHITE_QUEENSIDE;
+			}
+			if (square == toSquare(7, 7))
+			{
+				castlingMask[square] &= ~BLACK_KINGSIDE;
+			}
+			if (square == toSquare(0, 7))
+			{
+				castlingMask[square] &= ~BLACK_QUEENSIDE;
+			}
+
+			for (int d = 0; d < 8; d++)
+			{
+				rays[d][square] = 0;
+				for (int ri = i + raySteps[d][0], rj = j + raySteps[d][1]; ri >= 0 && ri <= 7 && rj >= 0 && rj <= 7; ri += raySteps[d][0], rj += raySteps[d][1])
+				{
+					rays[d][square] |= 1ULL << toSquare(ri, rj);
+				}
+			}
+		}
+
+	//every square along a ray shares that line with the square the ray starts from
+	for (int square = 0; square < 64; square++)
+		for (int d = 0; d < 8; d++)
+		{
+			Bitboard ray = rays[d][square];
+			while (ray)
+			{
+				int other = popLsb(ray);
+				between[square][other] = rays[d][square] & rays[d ^ 4][other];
+				lineThrough[square][other] = rays[d][square] | rays[d ^ 4][square] | 1ULL << square;
 			}
 		}
+
+	const int rookDirections[4] = { 0, 1, 4, 5 };
+	const int bishopDirections[4] = { 2, 3, 6, 7 };
+	usePext = cpuHasPext();
+	initSliders(rookMagics, rookTable, rookDirections);
+	initSliders(bishopMagics, bishopTable, bishopDirections);
 }
 
-int value(int i, int j)
+void initSliders(Magic* magics, Bitboard* table, const int* directions)
 {
-	switch (board[i][j])
+	//xorshift64* kept apart from the zobrist keys, reseeded on each rank with seeds known to find every magic quickly
+	const Bitboard seeds[8] = { 728, 10316, 55013, 32803, 12281, 15100, 16645, 255 };
+	Bitboard state = 0;
+	auto random = [&]()
 	{
-		case 0: return 0;
-			break;
-		case 1: return 1;
-			break;
-		case 2: return 1;
-			break;
-		case 3: return 5;
-			break;
-		case 4: return 5;
-			break;
-		case 5: return 3;
-			break;
-		case 6: return 3;
-			break;
-		case 7: return 3;
-			break;
-		case 8: return 3;
-			break;
-		case 9: return 9;
-			break;
-		case 10: return 9;
-			break;
-		case 11: return 21;
-			break;
-		case 12: return 21;
-			break;
-	}
-}
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 2685821657736338717ULL;
+	};
 
-void move(int depth)
-{
-	//build the minimax evaluation tree
-	int evaluate = maxEvaluation(depth);
+	std::vector<Bitboard> occupancies(4096);
+	std::vector<Bitboard> reference(4096);
+	std::vector<int> tried(4096);
+	Bitboard* next = table;
 
-	if (bestMoves.size() != 0)
+	for (int square = 0; square < 64; square++)
 	{
-		//choose one of the best available moves at random
-		int k = 4 * (rand() % (bestMoves.size() / 4));
+		//a piece on the last square of a ray never blocks anything beyond it, so the edges are left out
+		Magic& m = magics[square];
+		m.mask = 0;
+		for (int k = 0; k < 4; k++)
+		{
+			Bitboard ray = rays[directions[k]][square];
+			if (ray)
+			{
+				ray &= ~(1ULL << (directions[k] < 4 ? msb(ray) : lsb(ray)));
+			}
+			m.mask |= ray;
+		}
+
+		int bits = popCount(m.mask);
+		m.shift = 64 - bits;
+		m.attacks = next;
+		next += 1ULL << bits;
+
+		//walk every subset of the mask, working out the attacks the slow way once
+		int size = 0;
+		Bitboard subset = 0;
+		do
+		{
+			occupancies[size] = subset;
+			reference[size] = 0;
+			for (int k = 0; k < 4; k++)
+			{
+				reference[size] |= rayAttacks(directions[k], square, subset);
+			}
+			size++;
+			subset = (subset - m.mask) & m.mask;
+		} while (subset);
 
-		//filter for promotion cases
-		if (board[bestMoves[k]][bestMoves[k + 1]] == 1 && (bestMoves[k + 3] == 0 || bestMoves[k + 3] == 7))
+		if (usePext)
 		{
-			//automatically promote to a queen
-			board[bestMoves[k + 2]][bestMoves[k + 3]] = 9;
-			board[bestMoves[k]][bestMoves[k + 1]] = 0;
-			moveCounter++;
+			m.magic = 0;
+			for (int k = 0; k < size; k++)
+			{
+				m.attacks[pext(occupancies[k], m.mask)] = reference[k];
+			}
+			continue;
 		}
-		else
+
+		//try sparse random multipliers until one sends occupancies with different attacks to different indices
+		std::fill(tried.begin(), tried.end(), 0);
+		state = seeds[square / 8];
+		for (int attempt = 1; ; attempt++)
 		{
-			//apply the assigned mvoe and increment the move counter
-			board[bestMoves[k + 2]][bestMoves[k + 3]] = board[bestMoves[k]][bestMoves[k + 1]];
-			board[bestMoves[k]][bestMoves[k + 1]] = 0;
-			moveCounter++;
+			do
+			{
+				m.magic = random() & random() & random();
+			} while (popCount((m.mask * m.magic) >> 56) < 6);
+
+			bool works = true;
+			for (int k = 0; k < size && works; k++)
+			{
+				int index = sliderIndex(m, occupancies[k]);
+				if (tried[index] < attempt)
+				{
+					tried[index] = attempt;
+					m.attacks[index] = reference[k];
+				}
+				else if (m.attacks[index] != reference[k])
+				{
+					works = false;
+				}
+			}
+
+			if (works)
+			{
+				break;
+			}
 		}
+	}
+}
 
-		bestMoves.clear();
+int sliderIndex(const Magic& magic, Bitboard occupied)
+{
+	if (usePext)
+	{
+		return (int)pext(occupied, magic.mask);
 	}
-	else
+
+	return (int)(((occupied & magic.mask) * magic.magic) >> magic.shift);
+}
+
+bool cpuHasPext()
+{
+#if defined(PEXT_BUILD) && defined(_MSC_VER)
+	int info[4];
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 8)) != 0;
+#elif defined(PEXT_BUILD)
+	return __builtin_cpu_supports("bmi2");
+#else
+	return false;
+#endif
+}
+
+Bitboard pext(Bitboard b, Bitboard mask)
+{
+#if defined(PEXT_BUILD) && defined(_MSC_VER)
+	return _pext_u64(b, mask);
+#elif defined(PEXT_BUILD)
+	//written out rather than through the intrinsic, which would need the whole build to target BMI2
+	Bitboard result;
+	__asm__("pextq %2, %1, %0" : "=r"(result) : "r"(b), "rm"(mask));
+	return result;
+#else
+	//only called when cpuHasPext found the instruction
+	(void)b;
+	(void)mask;
+	return 0;
+#endif
+}
+
+Bitboard rayAttacks(int direction, int square, Bitboard occupied)
+{
+	//the ray stops at the first blocker, which is the nearest set bit in the direction of travel
+	Bitboard attacks = rays[direction][square];
+	Bitboard blockers = attacks & occupied;
+
+	if (blockers)
 	{
-		//if no good moves are found, the game is over
-		if (moveCounter % 2 == 0)
-		{
-			std::cout << "White has no good moves!" << std::endl;
-		}
-		else
+		int blocker = direction < 4 ? lsb(blockers) : msb(blockers);
+		attacks ^= rays[direction][blocker];
+	}
+
+	return attacks;
+}
+
+Bitboard rookAttacks(int square, Bitboard occupied)
+{
+	const Magic& m = rookMagics[square];
+	return m.attacks[sliderIndex(m, occupied)];
+}
+
+Bitboard bishopAttacks(int square, Bitboard occupied)
+{
+	const Magic& m = bishopMagics[square];
+	return m.attacks[sliderIndex(m, occupied)];
+}
+
+void initZobrist()
+{
+	for (int piece = 1; piece <= 12; piece++)
+		for (int square = 0; square < 64; square++)
 		{
-			std::cout << "Black has no good moves!" << std::endl;
+			zobristPieces[piece][square] = randomKey();
 		}
+
+	zobristSide = randomKey();
+	for (int rights = 0; rights < 16; rights++)
+	{
+		zobristCastling[rights] = randomKey();
+	}
+	for (int file = 0; file < 8; file++)
+	{
+		zobristEnPassant[file] = randomKey();
 	}
 }
 
-int maxEvaluation(int depth)
+Key randomKey()
 {
-	int maxEval = -60;
+	//xorshift64* with a fixed seed, so keys are the same on every run
+	static Key state = 1070372ULL;
+
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	return state * 2685821657736338717ULL;
+}
 
-	if (depth == MAX_DEPTH)
+void initBoard(Position& pos)
+{
+	for (int i = 0; i <= 7; i++)
 	{
-		//log and record all legal moves
-		logMoves();
-		std::vector<int> rollingLog = moveLog;
+		//initialise pawns
+		putPiece(pos, 1, toSquare(i, 1));
+		putPiece(pos, 2, toSquare(i, 6));
+	}
 
-		//for each legal move, test all possible outcomes and associate with each an evaluation
-		for (int i = 0; i < rollingLog.size(); i += 4)
-		{
-			//record the piece values at the positions that we intend to change
-			int fromPiece = board[rollingLog[i]][rollingLog[i + 1]];
-			int toPiece = board[rollingLog[i + 2]][rollingLog[i + 3]];
+	//initialise rooks
+	putPiece(pos, 3, toSquare(0, 0));
+	putPiece(pos, 3, toSquare(7, 0));
+	putPiece(pos, 4, toSquare(0, 7));
+	putPiece(pos, 4, toSquare(7, 7));
 
-			int tempEval = value(rollingLog[i + 2], rollingLog[i + 3]);
+	//initialise knights
+	putPiece(pos, 5, toSquare(1, 0));
+	putPiece(pos, 5, toSquare(6, 0));
+	putPiece(pos, 6, toSquare(1, 7));
+	putPiece(pos, 6, toSquare(6, 7));
 
-			//alter the board
-			board[rollingLog[i]][rollingLog[i + 1]] = 0;
-			board[rollingLog[i + 2]][rollingLog[i + 3]] = fromPiece;
+	//initialise bishops
+	putPiece(pos, 7, toSquare(2, 0));
+	putPiece(pos, 7, toSquare(5, 0));
+	putPiece(pos, 8, toSquare(2, 7));
+	putPiece(pos, 8, toSquare(5, 7));
 
-			//in the case of promotion we increase the board evaluation by 9 - 1 = 8;
-			if (fromPiece == 1 && (rollingLog[i + 3] == 7 || rollingLog[i + 3] == 0))
-			{
-				tempEval += 8;
-				board[rollingLog[i + 2]][rollingLog[i + 3]] = 9;
-			}
+	//initialise queens
+	putPiece(pos, 9, toSquare(3, 0));
+	putPiece(pos, 10, toSquare(3, 7));
 
-			moveCounter++;
-			flipBoard();
+	//initialise kings
+	putPiece(pos, 11, toSquare(4, 0));
+	putPiece(pos, 12, toSquare(4, 7));
 
-			//define the move evaluation recursively
-			int eval = tempEval - maxEvaluation(depth - 1);
+	//both sides may castle either way
+	pos.castling = WHITE_KINGSIDE | WHITE_QUEENSIDE | BLACK_KINGSIDE | BLACK_QUEENSIDE;
+	pos.key ^= zobristCastling[pos.castling];
+}
 
-			//reset the board
-			flipBoard();
-			moveCounter--;
-			board[rollingLog[i]][rollingLog[i + 1]] = fromPiece;
-			board[rollingLog[i + 2]][rollingLog[i + 3]] = toPiece;
+void initTestBoard(Position& pos)
+{
+	//move evaluation test
+	putPiece(pos, 8, toSquare(5, 7));
+	putPiece(pos, 6, toSquare(4, 6));
+	putPiece(pos, 2, toSquare(2, 6));
+	putPiece(pos, 7, toSquare(3, 5));
+	putPiece(pos, 3, toSquare(4, 0));
 
-			//record those moves that give the optimum evaluation
-			if (eval > maxEval)
-			{
-				maxEval = eval;
+	/*
+	//promotion test
+	putPiece(pos, 1, toSquare(2, 6));
+	putPiece(pos, 1, toSquare(3, 5));
+	putPiece(pos, 6, toSquare(4, 6));
+	putPiece(pos, 4, toSquare(7, 6));
+	*/
+}
 
-				bestMoves.clear();
-				for (int j = i; j <= i + 3; j++)
-				{
-					bestMoves.push_back(rollingLog[j]);
-				}
-			}
-			else if (eval == maxEval)
+void drawBoard(const Position& pos)
+{
+	for (int j = 7; j >= 0; j--)
+	{
+		for (int i = 0; i <= 7; i++)
+		{
+			switch (pos.squares[toSquare(i, j)])
 			{
-				for (int j = i; j <= i + 3; j++)
-				{
-					bestMoves.push_back(rollingLog[j]);
-				}
+				case 0: std::cout << "+";
+					break;
+				case 1: std::cout << "p";
+					break;
+				case 2: std::cout << "P";
+					break;
+				case 3: std::cout << "r";
+					break;
+				case 4: std::cout << "R";
+					break;
+				case 5: std::cout << "n";
+					break;
+				case 6: std::cout << "N";
+					break;
+				case 7: std::cout << "b";
+					break;
+				case 8: std::cout << "B";
+					break;
+				case 9: std::cout << "q";
+					break;
+				case 10: std::cout << "Q";
+					break;
+				case 11: std::cout << "k";
+					break;
+				case 12: std::cout << "K";
+					break;
 			}
+
+			std::cout << " ";
 		}
 
-		//return the evaluation at the base of our move space
-		return maxEval;
+		std::cout << std::endl;
 	}
-	else if (depth > 0) //recursively assign evaluations to each branch of the move space
-	{
-		logMoves();
-		std::vector<int> rollingLog = moveLog;
+}
 
-		for (int i = 0; i < rollingLog.size(); i += 4)
-		{
-			int fromPiece = board[rollingLog[i]][rollingLog[i + 1]];
-			int toPiece = board[rollingLog[i + 2]][rollingLog[i + 3]];
+int pieceType(int piece)
+{
+	return (piece + 1) / 2;
+}
 
-			int tempEval = value(rollingLog[i + 2], rollingLog[i + 3]);
+int pieceSide(int piece)
+{
+	return (piece + 1) % 2;
+}
 
-			board[rollingLog[i]][rollingLog[i + 1]] = 0;
-			board[rollingLog[i + 2]][rollingLog[i + 3]] = fromPiece;
+int makePiece(int type, int side)
+{
+	return 2 * type - 1 + side;
+}
 
-			if (fromPiece == 1 && (rollingLog[i + 3] == 7 || rollingLog[i + 3] == 0))
-			{
-				tempEval += 8;
-				board[rollingLog[i + 2]][rollingLog[i + 3]] = 9;
-			}
+void putPiece(Position& pos, int piece, int square)
+{
+	Bitboard bit = 1ULL << square;
 
-			moveCounter++;
-			flipBoard();
+	pos.pieces[piece] |= bit;
+	pos.sides[pieceSide(piece)] |= bit;
+	pos.occupied |= bit;
+	pos.squares[square] = piece;
+	pos.key ^= zobristPieces[piece][square];
+	pos.mg[pieceSide(piece)] += mgPieceSquare[piece][square];
+	pos.eg[pieceSide(piece)] += egPieceSquare[piece][square];
+	pos.phase += phaseWeights[pieceType(piece)];
 
-			int eval = tempEval - maxEvaluation(depth - 1);
+	if (useNetwork)
+	{
+		addFeature(pos, piece, square);
+	}
 
-			flipBoard();
-			moveCounter--;
-			board[rollingLog[i]][rollingLog[i + 1]] = fromPiece;
-			board[rollingLog[i + 2]][rollingLog[i + 3]] = toPiece;
+	if (pieceType(piece) == KING)
+	{
+		pos.kingSquares[pieceSide(piece)] = square;
+	}
+}
 
-			if (eval > maxEval)
-			{
-				maxEval = eval;
-			}
-		}
+void removePiece(Position& pos, int square)
+{
+	Bitboard bit = 1ULL << square;
+	int piece = pos.squares[square];
 
-		return maxEval;
+	pos.pieces[piece] &= ~bit;
+	pos.sides[pieceSide(piece)] &= ~bit;
+	pos.occupied &= ~bit;
+	pos.squares[square] = 0;
+	pos.key ^= zobristPieces[piece][square];
+	pos.mg[pieceSide(piece)] -= mgPieceSquare[piece][square];
+	pos.eg[pieceSide(piece)] -= egPieceSquare[piece][square];
+	pos.phase -= phaseWeights[pieceType(piece)];
+
+	if (useNetwork)
+	{
+		removeFeature(pos, piece, square);
+	}
+
+	if (pieceType(piece) == KING)
+	{
+		pos.kingSquares[pieceSide(piece)] = NO_SQUARE;
 	}
 }
 
-bool inCheck()
+void movePiece(Position& pos, int from, int to)
 {
-	for (int i = 0; i <= 7; i++)
-		for (int j = 0; j <= 7; j++)
-		{
-			if (board[i][j] == 11)
-			{
-				//check pawn attacks
-				if (moveCounter % 2 == 0)
-				{
-					if (j + 1 <= 7)
-					{
-						if (i - 1 >= 0)
-						{
-							if (board[i - 1][j + 1] == 2)
-							{
-								return true;
-							}
-						}
-						if (i + 1 <= 7)
-						{
-							if (board[i + 1][j + 1] == 2)
-							{
-								return true;
-							}
-						}
-					}
-				}
-				if (moveCounter % 2 == 1)
-				{
-					if (j - 1 >= 0)
-					{
-						if (i - 1 >= 0)
-						{
-							if (board[i - 1][j - 1] == 2)
-							{
-								return true;
-							}
-						}
-						if (i + 1 <= 7)
-						{
-							if (board[i + 1][j - 1] == 2)
-							{
-								return true;
-							}
-						}
-					}
-				}
+	int piece = pos.squares[from];
 
-				//check knights attacks
-				if (i + 2 <= 7)
-				{
-					if (j + 1 <= 7)
-					{
-						if (board[i + 2][j + 1] == 6)
-						{
-							return true;
-						}
-					}
-					if (j - 1 >= 0)
-					{
-						if (board[i + 2][j - 1] == 6)
-						{
-							return true;
-						}
-					}
-				}
-				if (i - 2 >= 0)
-				{
-					if (j + 1 <= 7)
-					{
-						if (board[i - 2][j + 1] == 6)
-						{
-							return true;
-						}
-					}
-					if (j - 1 >= 0)
-					{
-						if (board[i - 2][j - 1] == 6)
-						{
-							return true;
-						}
-					}
+	if (pos.squares[to] != 0)
+	{
+		removePiece(pos, to);
+	}
+
+	removePiece(pos, from);
+	putPiece(pos, piece, to);
+}
+
+Move encodeMove(int from, int to, int flags)
+{
+	return (Move)(from | to << 6 | flags << 12);
+}
+
+int moveFrom(Move move)
+{
+	return move & 63;
+}
+
+int moveTo(Move move)
+{
+	return (move >> 6) & 63;
+}
+
+int moveFlags(Move move)
+{
+	return move >> 12;
+}
+
+int promotionType(Move move)
+{
+	return (moveFlags(move) & PROMOTION) ? promotionTypes[moveFlags(move) & 3] : 0;
+}
+
+bool isCapture(Move move)
+{
+	return (moveFlags(move) & CAPTURE) != 0;
+}
+
+void makeMove(Position& pos, Move move, Undo& undo)
+{
+	int from = moveFrom(move);
+	int to = moveTo(move);
+	int flags = moveFlags(move);
+	int piece = pos.squares[from];
+	int side = pos.side;
+
+	undo.captured = pos.squares[to];
+	undo.promoted = 0;
+	undo.castling = pos.castling;
+	undo.epSquare = pos.epSquare;
+	undo.halfmoves = pos.halfmoves;
+	undo.key = pos.key;
+
+	if (pos.epSquare != NO_SQUARE)
+	{
+		pos.key ^= zobristEnPassant[pos.epSquare % 8];
+	}
+	pos.epSquare = NO_SQUARE;
+	pos.halfmoves++;
+
+	if (pieceType(piece) == PAWN)
+	{
+		pos.halfmoves = 0;
+	}
+
+	//an en passant capture takes the pawn beside the moving pawn rather than on its target square
+	if (flags == EN_PASSANT)
+	{
+		int capturedSquare = side == WHITE ? to - 8 : to + 8;
+		undo.captured = pos.squares[capturedSquare];
+		removePiece(pos, capturedSquare);
+	}
+
+	//a double push lets an enemy pawn alongside capture en passant on the next move only
+	if (flags == DOUBLE_PUSH)
+	{
+		int epSquare = (from + to) / 2;
+		if (pawnAttacks[side][epSquare] & pos.pieces[makePiece(PAWN, side ^ 1)])
+		{
+			pos.epSquare = epSquare;
+			pos.key ^= zobristEnPassant[epSquare % 8];
+		}
+	}
+
+	if (pos.squares[to] != 0)
+	{
+		pos.halfmoves = 0;
+		removePiece(pos, to);
+	}
+
+	removePiece(pos, from);
+	if (flags & PROMOTION)
+	{
+		undo.promoted = makePiece(promotionType(move), side);
+		putPiece(pos, undo.promoted, to);
+	}
+	else
+	{
+		putPiece(pos, piece, to);
+	}
+
+	//castling is written as the king's move, so the rook is brought across here
+	if (flags == KING_CASTLE)
+	{
+		movePiece(pos, to + 1, to - 1);
+	}
+	else if (flags == QUEEN_CASTLE)
+	{
+		movePiece(pos, to - 2, to + 1);
+	}
+
+	pos.key ^= zobristCastling[pos.castling];
+	pos.castling &= castlingMask[from] & castlingMask[to];
+	pos.key ^= zobristCastling[pos.castling];
+
+	pos.side ^= 1;
+	pos.key ^= zobristSide;
+	pos.moveCounter++;
+}
+
+void unmakeMove(Position& pos, Move move, const Undo& undo)
+{
+	pos.side ^= 1;
+	pos.moveCounter--;
+
+	int from = moveFrom(move);
+	int to = moveTo(move);
+	int flags = moveFlags(move);
+	int side = pos.side;
+	int piece = undo.promoted != 0 ? makePiece(PAWN, side) : pos.squares[to];
+
+	if (flags == KING_CASTLE)
+	{
+		movePiece(pos, to - 1, to + 1);
+	}
+	else if (flags == QUEEN_CASTLE)
+	{
+		movePiece(pos, to + 1, to - 2);
+	}
+
+	removePiece(pos, to);
+	putPiece(pos, piece, from);
+
+	if (flags == EN_PASSANT)
+	{
+		putPiece(pos, undo.captured, side == WHITE ? to - 8 : to + 8);
+	}
+	else if (undo.captured != 0)
+	{
+		putPiece(pos, undo.captured, to);
+	}
+
+	pos.castling = undo.castling;
+	pos.epSquare = undo.epSquare;
+	pos.halfmoves = undo.halfmoves;
+	pos.key = undo.key;
+}
+
+void makeNullMove(Position& pos, Undo& undo)
+{
+	undo.epSquare = pos.epSquare;
+	undo.halfmoves = pos.halfmoves;
+	undo.key = pos.key;
+
+	if (pos.epSquare != NO_SQUARE)
+	{
+		pos.key ^= zobristEnPassant[pos.epSquare % 8];
+	}
+	pos.epSquare = NO_SQUARE;
+	pos.halfmoves++;
+	pos.side ^= 1;
+	pos.key ^= zobristSide;
+}
+
+void unmakeNullMove(Position& pos, const Undo& undo)
+{
+	pos.side ^= 1;
+	pos.epSquare = undo.epSquare;
+	pos.halfmoves = undo.halfmoves;
+	pos.key = undo.key;
+}
+
+void playMoves(Position& pos, const std::string& moves)
+{
+	//plays a list of moves such as "e2e4 e7e5 e8g8 a7a8n", stopping at the first that is not available
+	std::istringstream stream(moves);
+	std::string text;
+	while (stream >> text)
+	{
+		Move move = parseMove(pos, text);
+		if (move == NO_MOVE)
+		{
+			return;
+		}
+
+		Undo undo;
+		makeMove(pos, move, undo);
+	}
+}
+
+Move parseMove(Position& pos, const std::string& text)
+{
+	if (text.size() < 4)
+	{
+		return NO_MOVE;
+	}
+
+	int iFrom = text[0] - 'a';
+	int jFrom = text[1] - '1';
+	int iTo = text[2] - 'a';
+	int jTo = text[3] - '1';
+	if (iFrom < 0 || iFrom > 7 || jFrom < 0 || jFrom > 7 || iTo < 0 || iTo > 7 || jTo < 0 || jTo > 7)
+	{
+		return NO_MOVE;
+	}
+
+	//promote to a queen unless told otherwise
+	const std::string promotionLetters = "  rnbq";
+	size_t letter = text.size() > 4 ? promotionLetters.find(text[4]) : std::string::npos;
+	int promotion = letter != std::string::npos && letter >= ROOK ? (int)letter : QUEEN;
+
+	MoveList log;
+	logMoves(pos, log);
+	for (int k = 0; k < log.size; k++)
+	{
+		Move move = log.moves[k];
+		if (moveFrom(move) == toSquare(iFrom, jFrom) && moveTo(move) == toSquare(iTo, jTo)
+			&& (promotionType(move) == 0 || promotionType(move) == promotion))
+		{
+			return move;
+		}
+	}
+
+	return NO_MOVE;
+}
+
+bool setFen(Position& pos, const std::string& fen)
+{
+	std::istringstream stream(fen);
+	std::string placement, side, castling, enPassant;
+	int halfmoves = 0, fullmoves = 1;
+	stream >> placement >> side >> castling >> enPassant >> halfmoves >> fullmoves;
+
+	const std::string pieceLetters = "PRNBQK";
+	Position parsed = Position();
+	int i = 0;
+	int j = 7;
+	for (char c : placement)
+	{
+		if (c == '/')
+		{
+			i = 0;
+			j--;
+		}
+		else if (c >= '1' && c <= '8')
+		{
+			i += c - '0';
+		}
+		else
+		{
+			//white pieces are odd, black pieces even
+			size_t letter = pieceLetters.find((char)toupper(c));
+			if (letter == std::string::npos || i > 7 || j < 0)
+			{
+				return false;
+			}
+
+			int piece = 2 * (int)letter + (c >= 'a' ? 2 : 1);
+			putPiece(parsed, piece, toSquare(i, j));
+			i++;
+		}
+	}
+
+	//each side needs exactly one king, as only one king square is kept for each
+	if (j != 0 || (side != "w" && side != "b")
+		|| popCount(parsed.pieces[makePiece(KING, WHITE)]) != 1 || popCount(parsed.pieces[makePiece(KING, BLACK)]) != 1)
+	{
+		return false;
+	}
+
+	if (side == "b")
+	{
+		parsed.side = BLACK;
+		parsed.key ^= zobristSide;
+	}
+
+	const std::string castlingLetters = "KQkq";
+	for (char c : castling)
+	{
+		size_t letter = castlingLetters.find(c);
+		if (letter != std::string::npos)
+		{
+			parsed.castling |= 1 << letter;
+		}
+	}
+
+	//a right is only kept while its king and rook are both on their home squares
+	const int castlingKings[4] = { 4, 4, 60, 60 };
+	const int castlingRooks[4] = { 7, 0, 63, 56 };
+	for (int k = 0; k < 4; k++)
+	{
+		int side = k < 2 ? WHITE : BLACK;
+		if (parsed.squares[castlingKings[k]] != makePiece(KING, side) || parsed.squares[castlingRooks[k]] != makePiece(ROOK, side))
+		{
+			parsed.castling &= ~(1 << k);
+		}
+	}
+	parsed.key ^= zobristCastling[parsed.castling];
+
+	//the en passant square is only kept when it is empty, on the side that just moved's third rank with
+	//that side's pawn in front of it, and a pawn is actually able to capture onto it
+	if (enPassant.size() == 2 && enPassant[0] >= 'a' && enPassant[0] <= 'h' && enPassant[1] == (parsed.side == WHITE ? '6' : '3'))
+	{
+		int epSquare = toSquare(enPassant[0] - 'a', enPassant[1] - '1');
+		int pushed = parsed.side == WHITE ? epSquare - 8 : epSquare + 8;
+		if (parsed.squares[epSquare] == 0 && parsed.squares[pushed] == makePiece(PAWN, parsed.side ^ 1)
+			&& (pawnAttacks[parsed.side ^ 1][epSquare] & parsed.pieces[makePiece(PAWN, parsed.side)]))
+		{
+			parsed.epSquare = epSquare;
+			parsed.key ^= zobristEnPassant[epSquare % 8];
+		}
+	}
+
+	parsed.halfmoves = halfmoves;
+	parsed.moveCounter = 2 * std::max(0, fullmoves - 1) + parsed.side;
+
+	//the side that has just moved cannot be left in check, and pawns never stand on the back ranks
+	Bitboard pawns = parsed.pieces[makePiece(PAWN, WHITE)] | parsed.pieces[makePiece(PAWN, BLACK)];
+	if (squareAttacked(parsed, parsed.kingSquares[parsed.side ^ 1], parsed.side) || (pawns & 0xFF000000000000FFULL))
+	{
+		return false;
+	}
+
+	pos = parsed;
+	return true;
+}
+
+std::string fenText(const Position& pos)
+{
+	const std::string pieceLetters = " PpRrNnBbQqKk";
+	std::string fen;
+	for (int j = 7; j >= 0; j--)
+	{
+		//runs of empty squares are counted
+		int empty = 0;
+		for (int i = 0; i <= 7; i++)
+		{
+			int piece = pos.squares[toSquare(i, j)];
+			if (piece == 0)
+			{
+				empty++;
+				continue;
+			}
+			if (empty > 0)
+			{
+				fen += (char)('0' + empty);
+				empty = 0;
+			}
+			fen += pieceLetters[piece];
+		}
+		if (empty > 0)
+		{
+			fen += (char)('0' + empty);
+		}
+		if (j > 0)
+		{
+			fen += '/';
+		}
+	}
+
+	fen += pos.side == WHITE ? " w " : " b ";
+	const std::string castlingLetters = "KQkq";
+	for (int k = 0; k < 4; k++)
+	{
+		if (pos.castling & 1 << k)
+		{
+			fen += castlingLetters[k];
+		}
+	}
+	if (pos.castling == 0)
+	{
+		fen += '-';
+	}
+
+	fen += ' ';
+	if (pos.epSquare != NO_SQUARE)
+	{
+		fen += (char)('a' + pos.epSquare % 8);
+		fen += (char)('1' + pos.epSquare / 8);
+	}
+	else
+	{
+		fen += '-';
+	}
+
+	return fen + " " + std::to_string(pos.halfmoves) + " " + std::to_string(pos.moveCounter / 2 + 1);
+}
+
+void startGame(Position& pos)
+{
+	pos = Position();
+	if (START_FEN.empty() || !setFen(pos, START_FEN))
+	{
+		initBoard(pos);
+	}
+}
+
+void move(const SearchLimits& limits)
+{
+	//a book move is played without searching
+	Move bookMove = probeBook(board);
+	if (bookMove != NO_MOVE)
+	{
+		Undo undo;
+		makeMove(board, bookMove, undo);
+		return;
+	}
+
+	search(mainSearch, board, limits);
+	playSearch();
+}
+
+void playSearch()
+{
+	const MoveList& bestMoves = mainSearch.threads[0]->chosenMoves;
+	if (SHOW_STATS)
+	{
+		printStats(mainSearch, std::cout);
+	}
+
+	if (bestMoves.size != 0)
+	{
+		//choose one of the best available moves at random
+		Move chosen = bestMoves.moves[rand() % bestMoves.size];
+
+		//apply the assigned move
+		Undo undo;
+		makeMove(board, chosen, undo);
+	}
+	else
+	{
+		//if no moves are available, the game is over
+		if (!inCheck(board))
+		{
+			std::cout << "Stalemate!" << std::endl;
+		}
+		else if (board.side == WHITE)
+		{
+			std::cout << "White is checkmated!" << std::endl;
+		}
+		else
+		{
+			std::cout << "Black is checkmated!" << std::endl;
+		}
+	}
+}
+
+void startPondering(const SearchLimits& limits)
+{
+	//the reply the table expects from the human, unless the game is over or the book will answer it
+	HashEntry entry;
+	MoveList pv;
+	if (!PONDER || !probeHash(hashTable, board.key, entry))
+	{
+		return;
+	}
+	hashPv(board, entry.move, 1, pv);
+	if (pv.size == 0)
+	{
+		return;
+	}
+
+	Position pos = board;
+	Undo undo;
+	makeMove(pos, pv.moves[0], undo);
+	if (probeBook(pos) != NO_MOVE)
+	{
+		return;
+	}
+
+	//the clock is not watched until the human plays, so the search deepens for as long as they think
+	ponderMove = pv.moves[0];
+	ponderSearch.stopRequested = false;
+	ponderSearch.pondering = true;
+	ponderWorker = std::thread([pos, limits]()
+	{
+		search(ponderSearch, pos, limits);
+	});
+}
+
+bool stopPondering(Move humanMove)
+{
+	if (!ponderWorker.joinable())
+	{
+		return false;
+	}
+
+	//on a miss the search is abandoned, leaving what it found in the table for the search of the
+	//move actually played
+	bool hit = humanMove == ponderMove;
+	ponderSearch.stopRequested = !hit;
+	ponderSearch.pondering = false;
+
+	//on a hit the time spent pondering counts toward the move, so a human who thought for longer
+	//than the AI's budget is answered at once
+	ponderWorker.join();
+	ponderMove = NO_MOVE;
+	if (!hit)
+	{
+		return false;
+	}
+
+	//the finished search becomes the game's, so the move and statistics are taken from mainSearch
+	mainSearch.limits = ponderSearch.limits;
+	mainSearch.start = ponderSearch.start.load();
+	mainSearch.threads.swap(ponderSearch.threads);
+	for (std::unique_ptr<SearchThread>& thread : mainSearch.threads)
+	{
+		thread->context = &mainSearch;
+	}
+	return true;
+}
+
+void search(SearchContext& context, const Position& pos, const SearchLimits& limits)
+{
+	context.table->generation++;
+	context.limits = limits;
+	context.start = std::chrono::steady_clock::now();
+	context.stop = false;
+
+	//every thread searches its own copy of the position, sharing only the transposition table
+	context.threads.clear();
+	for (int t = 0; t < std::max(1, THREADS); t++)
+	{
+		context.threads.emplace_back(new SearchThread());
+		context.threads[t]->index = t;
+		context.threads[t]->context = &context;
+		context.threads[t]->board = pos;
+		context.threads[t]->completedDepth = 0;
+		context.threads[t]->nodes = 0;
+		context.threads[t]->qnodes = 0;
+		context.threads[t]->allocations = 0;
+		context.threads[t]->stats = SearchStats();
+	}
+
+	//the helpers only fill the table; the main thread's result is the one that is played
+	std::vector<std::thread> helpers;
+	for (int t = 1; t < (int)context.threads.size(); t++)
+	{
+		helpers.emplace_back(iterativeDeepening, std::ref(*context.threads[t]));
+	}
+
+	iterativeDeepening(*context.threads[0]);
+
+	context.stop = true;
+	for (std::thread& helper : helpers)
+	{
+		helper.join();
+	}
+
+	if (!STATS_FILE.empty())
+	{
+		std::lock_guard<std::mutex> lock(statsOutput);
+		std::ofstream file(STATS_FILE, std::ios::app);
+		file << statsJson(context) << std::endl;
+	}
+}
+
+void iterativeDeepening(SearchThread& thread)
+{
+	Position& pos = thread.board;
+	SearchContext& context = *thread.context;
+	long long startAllocations = threadAllocations;
+
+	//log and record all legal moves, trying the move stored by an earlier search first
+	logMoves(pos, thread.rootLog);
+	std::fill(thread.rootScores, thread.rootScores + thread.rootLog.size, 0);
+	HashEntry entry;
+	if (probeHash(*context.table, pos.key, entry))
+	{
+		orderHashMove(thread.rootLog, entry.move);
+	}
+
+	//with a single legal move there is nothing to think about
+	thread.chosenMoves.size = 0;
+	if (thread.rootLog.size == 1)
+	{
+		thread.chosenMoves = thread.rootLog;
+		return;
+	}
+
+	//nor when the endgame tables hold the position: every move keeping the best distance to mate is as good as another
+	int tablebaseEval;
+	if (probeRoot(pos, thread.chosenMoves, tablebaseEval))
+	{
+		if (thread.index == 0 && uciMode)
+		{
+			uciInfo(thread, 1, tablebaseEval);
+		}
+		return;
+	}
+
+	//search one ply deeper each iteration until the budget runs out, keeping the result of the
+	//last iteration that finished. Odd helpers start a ply ahead of the main thread so that the
+	//threads spread over neighbouring depths rather than all searching the same tree
+	int lastEval = 0;
+	for (int depth = 1 + thread.index % 2; depth <= context.limits.depth && thread.rootLog.size > 1; depth++)
+	{
+		//start with a narrow window around the previous iteration's evaluation and widen it
+		//whenever the result falls outside
+		int window = ASPIRATION_WINDOW;
+		int alpha = thread.completedDepth == 0 ? -INFINITE_EVAL : lastEval - window;
+		int beta = thread.completedDepth == 0 ? INFINITE_EVAL : lastEval + window;
+		int iterationEval;
+
+		while (true)
+		{
+			//build the minimax evaluation tree
+			iterationEval = searchRoot(thread, depth, alpha, beta);
+
+			if (context.stop)
+			{
+				break;
+			}
+			else if (iterationEval <= alpha && alpha > -INFINITE_EVAL)
+			{
+				window *= 2;
+				alpha = std::max(iterationEval - window, -INFINITE_EVAL);
+			}
+			else if (iterationEval >= beta && beta < INFINITE_EVAL)
+			{
+				window *= 2;
+				beta = std::min(iterationEval + window, INFINITE_EVAL);
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		//an interrupted iteration has not looked at every move, so its result is discarded
+		if (context.stop)
+		{
+			break;
+		}
+
+		lastEval = iterationEval;
+		thread.chosenMoves = thread.bestMoves;
+		thread.completedDepth = depth;
+		orderRootMoves(thread.rootLog, thread.rootScores);
+		thread.iterationMoves[depth] = thread.chosenMoves.moves[0];
+		thread.iterationTimes[depth] = elapsedTime(context);
+		STAT(thread.stats.iterationNodes[depth] = thread.nodes + thread.qnodes);
+
+		if (thread.index == 0 && uciMode)
+		{
+			uciInfo(thread, depth, lastEval);
+		}
+
+		//helpers also rotate the moves after the best one, so each walks the rest of the tree
+		//in a different order
+		if (thread.index > 0 && thread.rootLog.size > 2)
+		{
+			int size = thread.rootLog.size;
+			int shift = thread.index % (size - 1);
+			std::rotate(thread.rootLog.moves + 1, thread.rootLog.moves + 1 + shift, thread.rootLog.moves + size);
+			std::rotate(thread.rootScores + 1, thread.rootScores + 1 + shift, thread.rootScores + size);
+		}
+
+		//the next iteration takes several times longer than this one, so do not start it if
+		//it has no chance of finishing
+		if (thread.index == 0 && !context.pondering && context.limits.moveTime > 0 && elapsedTime(context) * 2 > context.limits.moveTime)
+		{
+			break;
+		}
+	}
+
+	thread.allocations = threadAllocations - startAllocations;
+}
+
+int searchRoot(SearchThread& thread, int depth, int alpha, int beta)
+{
+	Position& pos = thread.board;
+	MoveList& rollingLog = thread.rootLog;
+	int maxEval = -INFINITE_EVAL;
+	thread.bestMoves.size = 0;
+	thread.nodes.store(thread.nodes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+	//for each legal move, test all possible outcomes and associate with each an evaluation
+	for (int i = 0; i < rollingLog.size; i++)
+	{
+		Move move = rollingLog.moves[i];
+
+		//alter the board
+		Undo undo;
+		makeMove(pos, move, undo);
+		thread.plyMoves[1] = move;
+
+		//the lower bound sits one below the best evaluation so that moves which tie with it are
+		//scored exactly, keeping the same set of best moves as a search without bounds
+		int lower = std::max(alpha, maxEval - 1);
+		int eval;
+		if (i == 0)
+		{
+			eval = -maxEvaluation(thread, depth - 1, 1, -beta, -lower);
+		}
+		else
+		{
+			//a window of width two separates worse moves, ties and improvements
+			eval = -maxEvaluation(thread, depth - 1, 1, -lower - 2, -lower);
+			if (eval >= lower + 2 && eval < beta)
+			{
+				eval = -maxEvaluation(thread, depth - 1, 1, -beta, -lower);
+			}
+		}
+
+		//reset the board
+		unmakeMove(pos, move, undo);
+
+		if (thread.context->stop)
+		{
+			break;
+		}
+
+		//keep every evaluation so the next iteration can search the most promising moves first
+		thread.rootScores[i] = eval;
+
+		//record those moves that give the optimum evaluation
+		if (eval > maxEval)
+		{
+			maxEval = eval;
+
+			thread.bestMoves.size = 0;
+			addMove(thread.bestMoves, move);
+
+			if (eval >= beta)
+			{
+				break;
+			}
+		}
+		else if (eval == maxEval)
+		{
+			addMove(thread.bestMoves, move);
+		}
+	}
+
+	//return the evaluation at the base of our move space
+	return maxEval;
+}
+
+void orderRootMoves(MoveList& log, int* scores)
+{
+	//insertion sort, which is stable so that equally scored moves keep their relative order,
+	//and needs no buffer from the heap
+	for (int k = 1; k < log.size; k++)
+	{
+		Move move = log.moves[k];
+		int score = scores[k];
+
+		int j = k;
+		for (; j > 0 && scores[j - 1] < score; j--)
+		{
+			log.moves[j] = log.moves[j - 1];
+			scores[j] = scores[j - 1];
+		}
+
+		log.moves[j] = move;
+		scores[j] = score;
+	}
+}
+
+long long elapsedTime(const SearchContext& context)
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - context.start.load()).count();
+}
+
+long long totalNodes(const SearchContext& context)
+{
+	long long nodes = 0;
+	for (const std::unique_ptr<SearchThread>& thread : context.threads)
+	{
+		nodes += thread->nodes.load(std::memory_order_relaxed) + thread->qnodes.load(std::memory_order_relaxed);
+	}
+
+	return nodes;
+}
+
+long long totalQNodes(const SearchContext& context)
+{
+	long long qnodes = 0;
+	for (const std::unique_ptr<SearchThread>& thread : context.threads)
+	{
+		qnodes += thread->qnodes.load(std::memory_order_relaxed);
+	}
+
+	return qnodes;
+}
+
+void checkLimits(SearchContext& context)
+{
+	//the first iteration always finishes so that there is a move to play
+	if (context.threads[0]->completedDepth == 0)
+	{
+		return;
+	}
+
+	if (context.stopRequested
+		|| (!context.pondering && context.limits.moveTime > 0 && elapsedTime(context) >= context.limits.moveTime)
+		|| (context.limits.nodes > 0 && totalNodes(context) >= context.limits.nodes))
+	{
+		context.stop = true;
+	}
+}
+
+void printStats(const SearchContext& context, std::ostream& out)
+{
+	const SearchThread& main = *context.threads[0];
+	long long time = std::max(1LL, elapsedTime(context));
+	out << "Search: depth " << main.completedDepth << ", " << context.threads.size() << (context.threads.size() == 1 ? " thread, " : " threads, ")
+		<< time << " ms, " << totalNodes(context) * 1000 / time << " nps" << std::endl;
+
+#if defined(STATS_BUILD)
+	//rows for each thread and for all of them together, as percentages of probes and of cutoffs
+	out << std::setw(8) << "Thread" << std::setw(14) << "Nodes" << std::setw(14) << "QNodes" << std::setw(12) << "NPS" << std::setw(10) << "TT hits"
+		<< std::setw(10) << "TT cuts" << std::setw(11) << "First cut" << std::setw(10) << "TB hits" << std::endl;
+	SearchStats all = SearchStats();
+	long long allNodes = 0, allQNodes = 0;
+	auto row = [&](const std::string& name, long long nodes, long long qnodes, const SearchStats& stats)
+	{
+		long long cutoffs = 0;
+		for (long long count : stats.cutoffs)
+		{
+			cutoffs += count;
+		}
+		out << std::setw(8) << name << std::setw(14) << nodes << std::setw(14) << qnodes << std::setw(12) << (nodes + qnodes) * 1000 / time
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(9) << 100.0 * stats.hashHits / std::max(1LL, stats.hashProbes) << "%"
+			<< std::setw(9) << 100.0 * stats.hashCuts / std::max(1LL, stats.hashProbes) << "%"
+			<< std::setw(10) << 100.0 * stats.cutoffs[0] / std::max(1LL, cutoffs) << "%" << std::setw(10) << stats.tablebaseHits << std::endl;
+	};
+	for (const std::unique_ptr<SearchThread>& thread : context.threads)
+	{
+		const SearchStats& stats = thread->stats;
+		row(std::to_string(thread->index), thread->nodes, thread->qnodes, stats);
+
+		allNodes += thread->nodes;
+		allQNodes += thread->qnodes;
+		all.hashProbes += stats.hashProbes;
+		all.hashHits += stats.hashHits;
+		all.hashCuts += stats.hashCuts;
+		all.tablebaseHits += stats.tablebaseHits;
+		for (int k = 0; k < CUTOFF_SLOTS; k++)
+		{
+			all.cutoffs[k] += stats.cutoffs[k];
+		}
+	}
+	if (context.threads.size() > 1)
+	{
+		row("All", allNodes, allQNodes, all);
+	}
+
+	//how often the first, second... move searched was the one to fail high; a well ordered search cuts on the first
+	long long cutoffs = 0;
+	for (long long count : all.cutoffs)
+	{
+		cutoffs += count;
+	}
+	out << "Cutoffs by move:";
+	for (int k = 0; k < CUTOFF_SLOTS; k++)
+	{
+		out << " " << k + 1 << (k == CUTOFF_SLOTS - 1 ? "+ " : " ") << std::setprecision(1) << 100.0 * all.cutoffs[k] / std::max(1LL, cutoffs) << "%";
+	}
+	out << std::endl;
+
+	//the effective branching factor is how many times longer each iteration took than the one before, in nodes
+	out << std::setw(8) << "Depth" << std::setw(14) << "Nodes" << std::setw(10) << "ms" << std::setw(8) << "EBF" << std::endl;
+	for (int depth = 1; depth <= main.completedDepth; depth++)
+	{
+		long long nodes = main.stats.iterationNodes[depth] - main.stats.iterationNodes[depth - 1];
+		long long previous = depth > 1 ? main.stats.iterationNodes[depth - 1] - main.stats.iterationNodes[depth - 2] : 0;
+		out << std::setw(8) << depth << std::setw(14) << nodes << std::setw(10) << main.iterationTimes[depth] - main.iterationTimes[depth - 1];
+		if (previous > 0)
+		{
+			out << std::setw(8) << std::setprecision(2) << (double)nodes / previous;
+		}
+		out << std::endl;
+	}
+	out.unsetf(std::ios::floatfield);
+#else
+	out << "Detailed counters were compiled out with NO_STATS" << std::endl;
+#endif
+}
+
+std::string statsJson(const SearchContext& context)
+{
+	const SearchThread& main = *context.threads[0];
+	std::ostringstream line;
+	line << "{\"depth\":" << main.completedDepth << ",\"time\":" << elapsedTime(context) << ",\"nodes\":" << totalNodes(context)
+		<< ",\"qnodes\":" << totalQNodes(context) << ",\"nps\":" << totalNodes(context) * 1000 / std::max(1LL, elapsedTime(context));
+
+#if defined(STATS_BUILD)
+	auto list = [&](const long long* values, int size)
+	{
+		line << "[";
+		for (int k = 0; k < size; k++)
+		{
+			line << (k > 0 ? "," : "") << values[k];
+		}
+		line << "]";
+	};
+
+	line << ",\"iterations\":[";
+	for (int depth = 1; depth <= main.completedDepth; depth++)
+	{
+		line << (depth > 1 ? "," : "") << "{\"depth\":" << depth << ",\"nodes\":" << main.stats.iterationNodes[depth] - main.stats.iterationNodes[depth - 1]
+			<< ",\"time\":" << main.iterationTimes[depth] - main.iterationTimes[depth - 1] << "}";
+	}
+	line << "],\"threads\":[";
+	for (const std::unique_ptr<SearchThread>& thread : context.threads)
+	{
+		const SearchStats& stats = thread->stats;
+		line << (thread->index > 0 ? "," : "") << "{\"nodes\":" << thread->nodes << ",\"qnodes\":" << thread->qnodes
+			<< ",\"hashProbes\":" << stats.hashProbes << ",\"hashHits\":" << stats.hashHits << ",\"hashCuts\":" << stats.hashCuts
+			<< ",\"tablebaseHits\":" << stats.tablebaseHits << ",\"cutoffs\":";
+		list(stats.cutoffs, CUTOFF_SLOTS);
+		line << "}";
+	}
+	line << "]";
+#endif
+
+	line << "}";
+	return line.str();
+}
+
+int difficultyTime(int level)
+{
+	//milliseconds per move for each menu difficulty, growing without bound past level 4
+	switch (level)
+	{
+		case 1: return 100;
+		case 2: return 1000;
+		case 3: return 3000;
+	}
+
+	return 10000 * std::max(1, level - 3);
+}
+
+bool parsePlayer(const std::string& text, SearchLimits& limits)
+{
+	limits = SearchLimits();
+	limits.moveTime = 0;
+
+	std::istringstream stream(text);
+	std::string item;
+	bool valid = false;
+	while (std::getline(stream, item, ','))
+	{
+		size_t equals = item.find('=');
+		std::string key = item.substr(0, equals);
+		long long value = equals != std::string::npos ? atoll(item.c_str() + equals + 1) : 0;
+
+		//"nmp=0" or "lmr=1" turns a selective search technique off or on for the player
+		const char* const* name = std::find(selectivityNames, selectivityNames + 5, key);
+		if (name != selectivityNames + 5 && equals != std::string::npos)
+		{
+			int flag = 1 << (name - selectivityNames);
+			limits.selectivity = value != 0 ? limits.selectivity | flag : limits.selectivity & ~flag;
+			continue;
+		}
+
+		if (value <= 0)
+		{
+			return false;
+		}
+
+		if (key == "depth")
+		{
+			limits.depth = (int)std::min(value, (long long)MAX_PLY);
+		}
+		else if (key == "time")
+		{
+			limits.moveTime = (int)value;
+		}
+		else if (key == "nodes")
+		{
+			limits.nodes = value;
+		}
+		else
+		{
+			return false;
+		}
+		valid = true;
+	}
+
+	return valid;
+}
+
+std::string playerName(const SearchLimits& limits)
+{
+	std::string name = "Chess-Client";
+	std::string separator = " ";
+	if (limits.depth < 64)
+	{
+		name += separator + "depth=" + std::to_string(limits.depth);
+		separator = ",";
+	}
+	if (limits.moveTime > 0)
+	{
+		name += separator + "time=" + std::to_string(limits.moveTime);
+		separator = ",";
+	}
+	if (limits.nodes > 0)
+	{
+		name += separator + "nodes=" + std::to_string(limits.nodes);
+		separator = ",";
+	}
+	for (int k = 0; k < 5; k++)
+	{
+		if (!(limits.selectivity & 1 << k))
+		{
+			name += separator + selectivityNames[k] + "=0";
+			separator = ",";
+		}
+	}
+	return name;
+}
+
+std::string sanText(Position& pos, Move move)
+{
+	int from = moveFrom(move);
+	int to = moveTo(move);
+	int piece = pos.squares[from];
+	const std::string pieceLetters = "  RNBQK";
+	std::string text;
+
+	if (moveFlags(move) == KING_CASTLE)
+	{
+		text = "O-O";
+	}
+	else if (moveFlags(move) == QUEEN_CASTLE)
+	{
+		text = "O-O-O";
+	}
+	else if (pieceType(piece) == PAWN)
+	{
+		if (isCapture(move))
+		{
+			text += (char)('a' + from % 8);
+			text += 'x';
+		}
+		text += moveText(move).substr(2, 2);
+		if (promotionType(move) != 0)
+		{
+			text += '=';
+			text += pieceLetters[promotionType(move)];
+		}
+	}
+	else
+	{
+		//name the file, failing that the rank, failing that both, when another piece of the same kind can go to the same square
+		MoveList log;
+		logMoves(pos, log);
+		bool ambiguous = false, sameFile = false, sameRank = false;
+		for (int k = 0; k < log.size; k++)
+		{
+			int other = moveFrom(log.moves[k]);
+			if (other != from && moveTo(log.moves[k]) == to && pos.squares[other] == piece)
+			{
+				ambiguous = true;
+				sameFile |= other % 8 == from % 8;
+				sameRank |= other / 8 == from / 8;
+			}
+		}
+
+		text += pieceLetters[pieceType(piece)];
+		if (ambiguous && (!sameFile || sameRank))
+		{
+			text += (char)('a' + from % 8);
+		}
+		if (ambiguous && sameFile)
+		{
+			text += (char)('1' + from / 8);
+		}
+		if (isCapture(move))
+		{
+			text += 'x';
+		}
+		text += moveText(move).substr(2, 2);
+	}
+
+	Undo undo;
+	makeMove(pos, move, undo);
+	if (inCheck(pos))
+	{
+		MoveList replies;
+		logMoves(pos, replies);
+		text += replies.size == 0 ? '#' : '+';
+	}
+	unmakeMove(pos, move, undo);
+
+	return text;
+}
+
+Move parseSan(Position& pos, const std::string& text)
+{
+	//check marks, annotations and the promotion sign are left out of the comparison, and castling may be written with zeros
+	auto plain = [](const std::string& san)
+	{
+		std::string letters;
+		for (char c : san)
+		{
+			if (std::string("+#!?=").find(c) == std::string::npos)
+			{
+				letters += c == '0' ? 'O' : c;
+			}
+		}
+		return letters;
+	};
+
+	std::string wanted = plain(text);
+	MoveList log;
+	logMoves(pos, log);
+	for (int k = 0; k < log.size; k++)
+	{
+		if (plain(sanText(pos, log.moves[k])) == wanted)
+		{
+			return log.moves[k];
+		}
+	}
+
+	return parseMove(pos, text);
+}
+
+bool insufficientMaterial(const Position& pos)
+{
+	//bare kings, or a lone knight or bishop against a bare king, cannot mate
+	Bitboard heavy = 0;
+	for (int type : { PAWN, ROOK, QUEEN })
+	{
+		heavy |= pos.pieces[makePiece(type, WHITE)] | pos.pieces[makePiece(type, BLACK)];
+	}
+	return heavy == 0 && popCount(pos.occupied) <= 3;
+}
+
+GameRecord playGame(SearchContext* contexts, const std::string& opening, const SearchLimits* players, int firstSide, int round, Key seed)
+{
+	GameRecord record = GameRecord();
+	record.firstSide = firstSide;
+
+	//each player starts the game knowing nothing, and learns nothing from the other player or other games
+	clearHash(*contexts[0].table);
+	clearHash(*contexts[1].table);
+
+	//an opening is a fen, or moves from the start position which then begin the game's record
+	Position pos = Position();
+	std::string fen;
+	if (opening.find('/') != std::string::npos && setFen(pos, opening))
+	{
+		fen = fenText(pos);
+	}
+	else
+	{
+		initBoard(pos);
+	}
+
+	Key history[MAX_GAME_PLIES + 1]; //keys of the positions so far, for spotting repetitions
+	int plies = 0;
+	history[plies++] = pos.key;
+	std::vector<std::string> tokens; //the movetext, wrapped once the game is over
+	auto play = [&](Move move)
+	{
+		if (pos.side == WHITE || tokens.empty())
+		{
+			tokens.push_back(std::to_string(pos.moveCounter / 2 + 1) + (pos.side == WHITE ? "." : "..."));
+		}
+		tokens.push_back(sanText(pos, move));
+
+		Undo undo;
+		makeMove(pos, move, undo);
+		history[plies++] = pos.key;
+	};
+
+	if (fen.empty())
+	{
+		std::istringstream stream(opening);
+		std::string text;
+		Move move;
+		while (plies < MAX_GAME_PLIES && stream >> text && (move = parseMove(pos, text)) != NO_MOVE)
+		{
+			play(move);
+		}
+	}
+
+	while (true)
+	{
+		MoveList log;
+		logMoves(pos, log);
+		if (log.size == 0)
+		{
+			record.result = !inCheck(pos) ? 0 : pos.side == WHITE ? -1 : 1;
+			record.termination = inCheck(pos) ? "checkmate" : "stalemate";
+			break;
+		}
+		if (pos.halfmoves >= 100)
+		{
+			record.termination = "fifty move rule";
+			break;
+		}
+		if (std::count(history, history + plies, pos.key) >= 3)
+		{
+			record.termination = "threefold repetition";
+			break;
+		}
+		if (insufficientMaterial(pos))
+		{
+			record.termination = "insufficient material";
+			break;
+		}
+		if (plies >= MAX_GAME_PLIES)
+		{
+			record.termination = "adjudicated on length";
+			break;
+		}
+
+		int player = pos.side == firstSide ? 0 : 1;
+		SearchContext& context = contexts[player];
+		search(context, pos, players[player]);
+		record.nodes[player] += totalNodes(context);
+		record.time[player] += elapsedTime(context);
+		record.moves[player]++;
+
+		//ties are broken by the game's own generator, so that concurrent games do not share one
+		const MoveList& bestMoves = context.threads[0]->chosenMoves;
+		seed ^= seed >> 12;
+		seed ^= seed << 25;
+		seed ^= seed >> 27;
+		play(bestMoves.size != 0 ? bestMoves.moves[(seed * 2685821657736338717ULL >> 32) % bestMoves.size] : log.moves[0]);
+	}
+
+	std::string result = record.result > 0 ? "1-0" : record.result < 0 ? "0-1" : "1/2-1/2";
+	std::ostringstream pgn;
+	pgn << "[Event \"Chess-Client self-play\"]" << std::endl
+		<< "[Site \"?\"]" << std::endl
+		<< "[Date \"????.??.??\"]" << std::endl
+		<< "[Round \"" << round << "\"]" << std::endl
+		<< "[White \"" << playerName(players[firstSide == WHITE ? 0 : 1]) << "\"]" << std::endl
+		<< "[Black \"" << playerName(players[firstSide == WHITE ? 1 : 0]) << "\"]" << std::endl
+		<< "[Result \"" << result << "\"]" << std::endl;
+	if (!fen.empty())
+	{
+		pgn << "[SetUp \"1\"]" << std::endl
+			<< "[FEN \"" << fen << "\"]" << std::endl;
+	}
+	pgn << std::endl;
+
+	//lines of movetext are kept under eighty characters
+	tokens.push_back("{" + record.termination + "}");
+	tokens.push_back(result);
+	size_t lineLength = 0;
+	for (const std::string& token : tokens)
+	{
+		if (lineLength > 0 && lineLength + 1 + token.size() > 79)
+		{
+			pgn << std::endl;
+			lineLength = 0;
+		}
+		pgn << (lineLength > 0 ? " " : "") << token;
+		lineLength += (lineLength > 0 ? 1 : 0) + token.size();
+	}
+	pgn << std::endl;
+
+	record.pgn = pgn.str();
+	return record;
+}
+
+void selfPlay(int games, int concurrency, const SearchLimits* players, const std::string& openingsFile, const std::string& pgnFile)
+{
+	//openings are read one to a line, each a fen or a list of moves such as "e2e4 e7e5 g1f3"
+	std::vector<std::string> openings;
+	if (openingsFile.empty())
+	{
+		openings.assign(std::begin(selfPlayOpenings), std::end(selfPlayOpenings));
+	}
+	else
+	{
+		std::ifstream file(openingsFile);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			line.erase(line.find_last_not_of(" \t\r") + 1);
+			if (!line.empty())
+			{
+				openings.push_back(line);
+			}
+		}
+		if (openings.empty())
+		{
+			std::cout << "No openings in " << openingsFile << std::endl;
+			return;
+		}
+	}
+
+	std::ofstream pgn(pgnFile);
+	if (!pgn)
+	{
+		std::cout << "Could not write " << pgnFile << std::endl;
+		return;
+	}
+
+	std::cout << "Playing " << games << " games, " << concurrency << " at a time: " << playerName(players[0]) << " against " << playerName(players[1]) << std::endl;
+
+	//each worker plays whole games with its own search, taking the next game as it finishes one;
+	//results are written out as they come in
+	std::mutex output;
+	std::atomic<int> nextGame(0);
+	int wins = 0, draws = 0, losses = 0; //for the first player
+	long long nodes[2] = { 0, 0 };
+	long long time[2] = { 0, 0 };
+	long long moves[2] = { 0, 0 };
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	auto worker = [&]()
+	{
+		//a search and a table for each player, kept from game to game
+		SearchContext contexts[2];
+		HashTable tables[2];
+		for (int player = 0; player < 2; player++)
+		{
+			resizeHash(tables[player], HASH_SIZE_MB);
+			contexts[player].table = &tables[player];
+		}
+
+		for (int game = nextGame++; game < games; game = nextGame++)
+		{
+			//each opening is played twice with the colours swapped, so that neither player gains from it
+			const std::string& opening = openings[(game / 2) % openings.size()];
+			int firstSide = game % 2 == 0 ? WHITE : BLACK;
+			GameRecord record = playGame(contexts, opening, players, firstSide, game + 1, 0x9E3779B97F4A7C15ULL * (game + 1));
+
+			std::lock_guard<std::mutex> lock(output);
+			pgn << record.pgn << std::endl;
+			int score = firstSide == WHITE ? record.result : -record.result;
+			wins += score > 0;
+			draws += score == 0;
+			losses += score < 0;
+			for (int player = 0; player < 2; player++)
+			{
+				nodes[player] += record.nodes[player];
+				time[player] += record.time[player];
+				moves[player] += record.moves[player];
+			}
+
+			std::cout << "Game " << game + 1 << ": " << (record.result > 0 ? "1-0" : record.result < 0 ? "0-1" : "1/2-1/2")
+				<< " " << record.termination << ", first player +" << wins << " =" << draws << " -" << losses << std::endl;
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (int t = 0; t < concurrency; t++)
+	{
+		pool.emplace_back(worker);
+	}
+	for (std::thread& thread : pool)
+	{
+		thread.join();
+	}
+
+	long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	int nameWidth = (int)std::max({ (size_t)34, playerName(players[0]).size(), playerName(players[1]).size() }) + 2; //names grow with the techniques turned off
+	std::cout << std::endl << "Games: " << games << " in " << std::fixed << std::setprecision(1) << elapsed / 1000.0 << " s" << std::endl
+		<< "First player W/D/L: " << wins << "/" << draws << "/" << losses
+		<< " (" << (games > 0 ? 100.0 * (wins + draws / 2.0) / games : 0.0) << "%)" << std::endl
+		<< std::endl << std::left << std::setw(nameWidth) << "Player" << std::right << std::setw(10) << "Moves" << std::setw(14) << "Nodes/move"
+		<< std::setw(14) << "ms/move" << std::endl;
+	for (int player = 0; player < 2; player++)
+	{
+		std::cout << std::left << std::setw(nameWidth) << playerName(players[player]) << std::right << std::setw(10) << moves[player]
+			<< std::setw(14) << nodes[player] / std::max(1LL, moves[player])
+			<< std::setw(14) << std::setprecision(1) << (double)time[player] / std::max(1LL, moves[player]) << std::endl;
+	}
+	std::cout << "PGN written to " << pgnFile << std::endl;
+}
+
+bool parseEpd(const std::string& line, EpdPosition& epd)
+{
+	//four fields of fen, sometimes followed by the move counters, then operations each ended by a semicolon
+	std::istringstream stream(line);
+	std::string fen, field;
+	for (int k = 0; k < 4 && stream >> field; k++)
+	{
+		fen += (k > 0 ? " " : "") + field;
+	}
+	std::string counters;
+	while (stream >> std::ws && isdigit(stream.peek()) && stream >> field)
+	{
+		counters += " " + field;
+	}
+
+	epd = EpdPosition();
+	if (!setFen(epd.pos, fen + counters))
+	{
+		return false;
+	}
+
+	std::string operation;
+	while (std::getline(stream, operation, ';'))
+	{
+		std::istringstream operands(operation);
+		std::string opcode, operand;
+		operands >> opcode;
+		if (opcode == "bm" || opcode == "am")
+		{
+			while (operands >> operand)
+			{
+				Move move = parseSan(epd.pos, operand);
+				if (move == NO_MOVE)
+				{
+					return false;
+				}
+				addMove(opcode == "bm" ? epd.best : epd.avoid, move);
+			}
+		}
+		else if (opcode == "id")
+		{
+			std::getline(operands >> std::ws, epd.id);
+			epd.id.erase(std::remove(epd.id.begin(), epd.id.end(), '"'), epd.id.end());
+		}
+	}
+
+	return epd.best.size > 0 || epd.avoid.size > 0;
+}
+
+bool epdSolved(const EpdPosition& epd, Move move)
+{
+	return move != NO_MOVE && (epd.best.size == 0 || std::count(epd.best.moves, epd.best.moves + epd.best.size, move) > 0)
+		&& std::count(epd.avoid.moves, epd.avoid.moves + epd.avoid.size, move) == 0;
+}
+
+void epdCommand(const std::string& path, int moveTime, int concurrency)
+{
+	std::ifstream file(path);
+	if (!file)
+	{
+		std::cout << "Could not read " << path << std::endl;
+		return;
+	}
+
+	SearchLimits epdLimits;
+	epdLimits.moveTime = moveTime;
+	std::cout << "Searching " << path << " for " << moveTime << " ms a position, " << concurrency << " at a time" << std::endl
+		<< std::setw(6) << "Line" << std::setw(20) << "Id" << std::setw(8) << "Result" << std::setw(8) << "Move"
+		<< std::setw(16) << "Expected" << std::setw(8) << "Depth" << std::setw(10) << "ms" << std::endl;
+
+	//the file is read a line at a time by whichever worker is free, so suites of any length start at once
+	//and are never held in memory; each position is reported as soon as it is searched
+	std::mutex input, output;
+	int lineNumber = 0;
+	int positions = 0, solved = 0, skipped = 0;
+	long long solutionTime = 0; //summed over the solved positions
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	auto worker = [&]()
+	{
+		//each worker searches with its own table, cleared for every position, so that results depend on
+		//neither the order of the suite nor how many positions are searched at once
+		SearchContext context;
+		HashTable table;
+		resizeHash(table, HASH_SIZE_MB);
+		context.table = &table;
+		std::string line;
+		EpdPosition epd;
+		while (true)
+		{
+			int number;
+			{
+				std::lock_guard<std::mutex> lock(input);
+				if (!std::getline(file, line))
+				{
+					return;
+				}
+				number = ++lineNumber;
+			}
+
+			line.erase(line.find_last_not_of(" \t\r") + 1);
+			if (line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+			if (!parseEpd(line, epd))
+			{
+				std::lock_guard<std::mutex> lock(output);
+				skipped++;
+				std::cout << std::setw(6) << number << "  could not read " << line << std::endl;
+				continue;
+			}
+
+			clearHash(table);
+			search(context, epd.pos, epdLimits);
+
+			//the solution was found when the main thread first settled on a right move it then kept
+			const SearchThread& main = *context.threads[0];
+			Move move = main.chosenMoves.size != 0 ? main.chosenMoves.moves[0] : NO_MOVE;
+			bool correct = epdSolved(epd, move);
+			int depth = main.completedDepth;
+			while (correct && depth > 1 && epdSolved(epd, main.iterationMoves[depth - 1]))
+			{
+				depth--;
+			}
+			long long time = main.completedDepth > 0 ? main.iterationTimes[depth] : elapsedTime(context);
+
+			std::string expected;
+			const MoveList& shown = epd.best.size > 0 ? epd.best : epd.avoid;
+			for (int k = 0; k < shown.size; k++)
+			{
+				expected += (k > 0 ? " " : epd.best.size > 0 ? "bm " : "am ") + sanText(epd.pos, shown.moves[k]);
+			}
+
+			std::lock_guard<std::mutex> lock(output);
+			positions++;
+			solved += correct;
+			solutionTime += correct ? time : 0;
+			std::cout << std::setw(6) << number << std::setw(20) << (epd.id.size() > 18 ? epd.id.substr(0, 18) : epd.id)
+				<< std::setw(8) << (correct ? "solved" : "failed") << std::setw(8) << (move != NO_MOVE ? sanText(epd.pos, move) : "none")
+				<< std::setw(16) << expected << std::setw(8) << (correct ? depth : main.completedDepth) << std::setw(10) << (correct ? time : elapsedTime(context)) << std::endl;
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (int t = 0; t < concurrency; t++)
+	{
+		pool.emplace_back(worker);
+	}
+	for (std::thread& thread : pool)
+	{
+		thread.join();
+	}
+
+	long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	std::cout << std::endl << "Positions: " << positions << (skipped > 0 ? ", " + std::to_string(skipped) + " skipped" : "") << std::endl
+		<< "Solved: " << solved << " (" << std::fixed << std::setprecision(1) << 100.0 * solved / std::max(1, positions) << "%)" << std::endl
+		<< "Average time to solution: " << solutionTime / std::max(1, solved) << " ms" << std::endl
+		<< "Time: " << elapsed / 1000.0 << " s" << std::endl;
+	std::cout.unsetf(std::ios::floatfield);
+}
+
+void* operator new(size_t size)
+{
+	//every heap allocation in the program passes through here, so searches can count their own
+	threadAllocations++;
+	if (void* memory = std::malloc(size == 0 ? 1 : size))
+	{
+		return memory;
+	}
+
+	throw std::bad_alloc();
+}
+
+//kept out of line, as gcc otherwise sees free inlined against the standard allocator's new and warns of a mismatch
+NOINLINE void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+NOINLINE void operator delete(void* memory, size_t) noexcept
+{
+	std::free(memory);
+}
+
+void smpBenchmark(int maxThreads, int moveTime)
+{
+	//a few opening and middlegame positions, searched for a fixed time with each thread count
+	const std::string lines[] = {
+		"",
+		"e2e4 e7e5 g1f3 b8c6 f1c4 g8f6 d2d3 f8c5",
+		"d2d4 d7d5 c2c4 e7e6 b1c3 g8f6 c1g5 f8e7"
+	};
+
+	std::cout << std::setw(8) << "Threads" << std::setw(14) << "Nodes" << std::setw(14) << "QNodes" << std::setw(12) << "NPS" << std::setw(10) << "Scaling"
+		<< std::setw(13) << "Allocations" << std::endl;
+
+	//double the thread count each row, finishing on the requested maximum
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	double baseNps = 0;
+	for (int threads : threadCounts)
+	{
+		THREADS = threads;
+		long long nodes = 0;
+		long long qnodes = 0;
+		long long time = 0;
+		long long allocations = 0;
+
+		for (const std::string& line : lines)
+		{
+			Position pos = Position();
+			initBoard(pos);
+			playMoves(pos, line);
+
+			clearHash(hashTable);
+			SearchLimits benchLimits;
+			benchLimits.moveTime = moveTime;
+			search(mainSearch, pos, benchLimits);
+
+			nodes += totalNodes(mainSearch);
+			qnodes += totalQNodes(mainSearch);
+			time += std::max(1LL, elapsedTime(mainSearch));
+
+			//made by the search threads once searching, leaving out setting them up
+			for (const std::unique_ptr<SearchThread>& thread : mainSearch.threads)
+			{
+				allocations += thread->allocations;
+			}
+		}
+
+		double nps = nodes * 1000.0 / time;
+		if (threads == 1)
+		{
+			baseNps = nps;
+		}
+
+		std::cout << std::setw(8) << threads << std::setw(14) << nodes << std::setw(14) << qnodes << std::setw(12) << (long long)nps
+			<< std::setw(9) << std::fixed << std::setprecision(2) << nps / baseNps << "x" << std::setw(13) << allocations << std::endl;
+	}
+}
+
+int maxEvaluation(SearchThread& thread, int depth, int ply, int alpha, int beta)
+{
+	Position& pos = thread.board;
+	long long nodes = thread.nodes.load(std::memory_order_relaxed) + 1;
+	thread.nodes.store(nodes, std::memory_order_relaxed);
+
+	//the main thread polls the clock every few thousand nodes; once stopped, every thread
+	//unwinds without searching further
+	if (thread.index == 0 && (nodes & 2047) == 0)
+	{
+		checkLimits(*thread.context);
+	}
+	if (thread.context->stop.load(std::memory_order_relaxed))
+	{
+		return 0;
+	}
+	if (ply >= MAX_PLY - 1)
+	{
+		return evaluate(pos);
+	}
+
+	//positions the endgame tables hold are scored exactly, by their distance to mate
+	if (popCount(pos.occupied) <= tablebaseMen)
+	{
+		int value = probeTablebase(pos);
+		if (value >= 0)
+		{
+			STAT(thread.stats.tablebaseHits++);
+			return tablebaseScore(value, ply);
+		}
+	}
+
+	if (depth == 0)
+	{
+		//settle any captures still hanging before judging the position
+		return quiescence(thread, ply, alpha, beta);
+	}
+
+	//positions already searched deeply enough can return their stored evaluation
+	Key key = pos.key;
+	HashEntry entry;
+	Move hashMove = NO_MOVE;
+	STAT(thread.stats.hashProbes++);
+	if (probeHash(*thread.context->table, key, entry))
+	{
+		STAT(thread.stats.hashHits++);
+		if (entry.depth >= depth)
+		{
+			int score = scoreFromHash(entry.score, ply);
+			if (entry.bound == BOUND_EXACT
+				|| (entry.bound == BOUND_LOWER && score >= beta)
+				|| (entry.bound == BOUND_UPPER && score <= alpha))
+			{
+				STAT(thread.stats.hashCuts++);
+				return score;
+			}
+		}
+
+		hashMove = entry.move;
+	}
+
+	//away from the principal variation the static evaluation can settle a position far outside the window
+	//without searching it, unless a mate is at stake or the side to move is in check
+	int selectivity = thread.context->limits.selectivity;
+	bool check = inCheck(pos);
+	bool pvNode = beta - alpha > 1;
+	bool pruning = !pvNode && !check && std::abs(beta) < MATE_BOUND;
+	int staticEval = check ? -INFINITE_EVAL : evaluate(pos);
+
+	//reverse futility pruning: so far above beta that the opponent could not catch up with a margin for
+	//every ply left
+	if (pruning && (selectivity & REVERSE_FUTILITY) && depth <= REVERSE_FUTILITY_DEPTH
+		&& staticEval - REVERSE_FUTILITY_MARGIN * depth >= beta)
+	{
+		return staticEval;
+	}
+
+	//razoring: so far below alpha that only a capture could help, so the capture search decides
+	if (pruning && (selectivity & RAZORING) && depth <= RAZOR_DEPTH && staticEval + RAZOR_MARGIN * depth <= alpha)
+	{
+		int eval = quiescence(thread, ply, alpha, beta);
+		if (eval <= alpha)
+		{
+			return eval;
+		}
+	}
+
+	//null move pruning: if passing still fails high after a reduced search, a real move would too. That
+	//fails in zugzwang, where every move is worse than passing, so there is no null move with only pawns
+	//left, straight after another, or while a deep cutoff is being verified by searching without one
+	Bitboard officers = pos.sides[pos.side] & ~pos.pieces[makePiece(PAWN, pos.side)] & ~pos.pieces[makePiece(KING, pos.side)];
+	if (pruning && (selectivity & NULL_MOVE) && depth >= NULL_MOVE_DEPTH && staticEval >= beta && officers != 0
+		&& thread.plyMoves[ply] != NO_MOVE && ply >= thread.nullMinPly)
+	{
+		int reduced = std::max(0, depth - 4 - depth / 6);
+		Undo undo;
+		makeNullMove(pos, undo);
+		thread.plyMoves[ply + 1] = NO_MOVE;
+		int eval = -maxEvaluation(thread, reduced, ply + 1, -beta, -beta + 1);
+		unmakeNullMove(pos, undo);
+
+		if (eval >= beta)
+		{
+			//a mate found after passing is not a mate the position can force
+			eval = std::min(eval, MATE_BOUND - 1);
+			if (thread.nullMinPly > 0 || depth < NULL_VERIFY_DEPTH)
+			{
+				return eval;
+			}
+
+			thread.nullMinPly = ply + 3 * reduced / 4;
+			int verified = maxEvaluation(thread, reduced, ply, beta - 1, beta);
+			thread.nullMinPly = 0;
+			if (verified >= beta)
+			{
+				return eval;
+			}
+		}
+	}
+
+	//futility pruning: near the leaves a quiet move cannot make up the distance to alpha, so once one
+	//move has been searched the rest are skipped, unless they give check
+	int futilityEval = staticEval + FUTILITY_MARGIN * depth;
+	bool futile = pruning && (selectivity & FUTILITY) && depth <= FUTILITY_DEPTH && futilityEval <= alpha;
+
+	int maxEval = -INFINITE_EVAL;
+	Move bestMove = NO_MOVE;
+
+	MoveList rollingLog;
+	logMoves(pos, rollingLog);
+	orderMoves(thread, rollingLog, hashMove, ply);
+
+	//quiet moves searched without a cutoff, penalised in the history if a later one gives it
+	Move quiets[MAX_MOVES];
+	int quietCount = 0;
+
+	for (int i = 0; i < rollingLog.size; i++)
+	{
+		Move move = rollingLog.moves[i];
+		bool quiet = !isCapture(move) && promotionType(move) == 0;
+		int history = quiet ? thread.history[pos.side][moveFrom(move)][moveTo(move)] : 0;
+
+		Undo undo;
+		makeMove(pos, move, undo);
+		thread.plyMoves[ply + 1] = move;
+		bool givesCheck = inCheck(pos);
+
+		if (futile && quiet && i > 0 && !givesCheck)
+		{
+			unmakeMove(pos, move, undo);
+			maxEval = std::max(maxEval, futilityEval);
+			continue;
+		}
+
+		//the child sees the window from the other side
+		int lower = std::max(alpha, maxEval);
+		int eval;
+		if (i == 0)
+		{
+			eval = -maxEvaluation(thread, depth - 1, ply + 1, -beta, -lower);
+		}
+		else
+		{
+			//late move reductions: quiet moves far down the ordering seldom cut, so they are searched less
+			//deeply, the more so the later they come and the worse their history, and again at full depth
+			//if they beat alpha after all
+			int reduction = 0;
+			if ((selectivity & LATE_REDUCTIONS) && quiet && depth >= LMR_DEPTH && i >= LMR_MOVES && !check && !givesCheck)
+			{
+				reduction = lateReductions[std::min(depth, 63)][std::min(i + 1, 63)] - (pvNode ? 1 : 0) - history / (HISTORY_MAX / 2);
+				reduction = std::max(0, std::min(reduction, depth - 2));
+			}
+
+			//principal variation search: prove the remaining moves worse with a null window,
+			//and only search them properly when that proof fails
+			eval = -maxEvaluation(thread, depth - 1 - reduction, ply + 1, -lower - 1, -lower);
+			if (reduction > 0 && eval > lower)
+			{
+				eval = -maxEvaluation(thread, depth - 1, ply + 1, -lower - 1, -lower);
+			}
+			if (eval > lower && eval < beta)
+			{
+				eval = -maxEvaluation(thread, depth - 1, ply + 1, -beta, -lower);
+			}
+		}
+
+		unmakeMove(pos, move, undo);
+
+		if (eval > maxEval)
+		{
+			maxEval = eval;
+
+			if (eval > alpha)
+			{
+				bestMove = move;
+			}
+
+			//the opponent will never allow this line, so the remaining moves need not be searched
+			if (eval >= beta)
+			{
+				STAT(thread.stats.cutoffs[std::min(i, CUTOFF_SLOTS - 1)]++);
+				if (quiet)
+				{
+					updateHistory(thread, move, ply, depth, quiets, quietCount);
+				}
+				break;
+			}
+		}
+
+		if (quiet)
+		{
+			quiets[quietCount++] = move;
+		}
+	}
+
+	//an interrupted search has not seen every move, so its evaluation is not stored
+	if (thread.context->stop.load(std::memory_order_relaxed))
+	{
+		return 0;
+	}
+
+	//with no moves the game is over: checkmate, or a draw by stalemate
+	if (rollingLog.size == 0)
+	{
+		maxEval = check ? -MATE_EVAL + ply : 0;
+	}
+
+	int bound = maxEval >= beta ? BOUND_LOWER : maxEval > alpha ? BOUND_EXACT : BOUND_UPPER;
+	storeHash(*thread.context->table, key, depth, bound, scoreToHash(maxEval, ply), bestMove);
+
+	return maxEval;
+}
+
+int quiescence(SearchThread& thread, int ply, int alpha, int beta)
+{
+	Position& pos = thread.board;
+	long long qnodes = thread.qnodes.load(std::memory_order_relaxed) + 1;
+	thread.qnodes.store(qnodes, std::memory_order_relaxed);
+
+	if (thread.index == 0 && (qnodes & 2047) == 0)
+	{
+		checkLimits(*thread.context);
+	}
+	if (thread.context->stop.load(std::memory_order_relaxed))
+	{
+		return 0;
+	}
+	if (ply >= MAX_PLY)
+	{
+		return evaluate(pos);
+	}
+
+	//the side to move may stand pat on the static evaluation rather than capture. In check there is
+	//no standing pat, and every evasion is searched
+	bool check = inCheck(pos);
+	int maxEval = -MATE_EVAL + ply;
+	int standPat = 0;
+	if (!check)
+	{
+		standPat = evaluate(pos);
+		maxEval = standPat;
+		if (maxEval >= beta)
+		{
+			return maxEval;
+		}
+	}
+
+	MoveList rollingLog;
+	logMoves(pos, rollingLog, !check);
+	orderCaptures(pos, rollingLog);
+
+	for (int i = 0; i < rollingLog.size; i++)
+	{
+		Move move = rollingLog.moves[i];
+		int lower = std::max(alpha, maxEval);
+		int captured = moveFlags(move) == EN_PASSANT ? makePiece(PAWN, pos.side ^ 1) : pos.squares[moveTo(move)];
+		int gain = pieceValues[captured] + (promotionType(move) ? pieceValues[makePiece(promotionType(move), pos.side)] - 100 : 0);
+
+		//delta pruning: a capture that leaves us short of alpha even if the piece comes for free and the
+		//position then swings a little more our way is not worth searching
+		if (!check && standPat + gain + DELTA_MARGIN <= lower)
+		{
+			continue;
+		}
+
+		Undo undo;
+		makeMove(pos, move, undo);
+		int eval = -quiescence(thread, ply + 1, -beta, -lower);
+		unmakeMove(pos, move, undo);
+
+		if (eval > maxEval)
+		{
+			maxEval = eval;
+
+			if (eval >= beta)
+			{
+				break;
+			}
+		}
+	}
+
+	return maxEval;
+}
+
+void orderCaptures(const Position& pos, MoveList& log)
+{
+	//taking the biggest piece with the smallest one usually refutes the position soonest, which keeps
+	//the capture search from wandering through every exchange; quiet evasions keep their order last
+	int scores[MAX_MOVES];
+	for (int i = 0; i < log.size; i++)
+	{
+		Move move = log.moves[i];
+		int victim = moveFlags(move) == EN_PASSANT ? makePiece(PAWN, pos.side ^ 1) : pos.squares[moveTo(move)];
+		int promotion = promotionType(move) ? pieceValues[makePiece(promotionType(move), pos.side)] : 0;
+		scores[i] = victim != 0 || promotion != 0 ? 10 * (pieceValues[victim] + promotion) - pieceValues[pos.squares[moveFrom(move)]] + 1000 : 0;
+	}
+
+	for (int k = 1; k < log.size; k++)
+	{
+		Move move = log.moves[k];
+		int score = scores[k];
+
+		int j = k;
+		for (; j > 0 && scores[j - 1] < score; j--)
+		{
+			log.moves[j] = log.moves[j - 1];
+			scores[j] = scores[j - 1];
+		}
+
+		log.moves[j] = move;
+		scores[j] = score;
+	}
+}
+
+void orderMoves(const SearchThread& thread, MoveList& log, Move hashMove, int ply)
+{
+	//the move the table remembers is usually best, then captures that the exchange on the square does not
+	//lose, in the order orderCaptures gives them, then the quiet moves that refuted this ply and the
+	//opponent's last move elsewhere in the tree, then the other quiet moves by how often they have
+	//refuted anything, and captures that lose material last
+	const Position& pos = thread.board;
+	Move previous = thread.plyMoves[ply];
+	Move counter = previous != NO_MOVE ? thread.counterMoves[pos.squares[moveTo(previous)]][moveTo(previous)] : NO_MOVE;
+	int scores[MAX_MOVES];
+	for (int i = 0; i < log.size; i++)
+	{
+		Move move = log.moves[i];
+		int from = moveFrom(move);
+		int to = moveTo(move);
+		if (move == hashMove)
+		{
+			scores[i] = 4000000;
+		}
+		else if (isCapture(move) || promotionType(move) != 0)
+		{
+			int victim = moveFlags(move) == EN_PASSANT ? makePiece(PAWN, pos.side ^ 1) : pos.squares[to];
+			int promotion = promotionType(move) ? pieceValues[makePiece(promotionType(move), pos.side)] : 0;
+			int attacker = pieceValues[pos.squares[from]];
+			int order = 10 * (pieceValues[victim] + promotion) - attacker;
+
+			//taking a piece worth at least the one taking it cannot lose material, so only the other
+			//captures need their exchange played out
+			bool winning = attacker <= pieceValues[victim] + promotion || see(pos, move) >= 0;
+			scores[i] = (winning ? 3000000 : -3000000) + order;
+		}
+		else if (move == thread.killers[ply][0])
+		{
+			scores[i] = 2000002;
+		}
+		else if (move == thread.killers[ply][1])
+		{
+			scores[i] = 2000001;
+		}
+		else if (move == counter)
+		{
+			scores[i] = 2000000;
+		}
+		else
+		{
+			scores[i] = thread.history[pos.side][from][to];
+		}
+	}
+
+	for (int k = 1; k < log.size; k++)
+	{
+		Move move = log.moves[k];
+		int score = scores[k];
+
+		int j = k;
+		for (; j > 0 && scores[j - 1] < score; j--)
+		{
+			log.moves[j] = log.moves[j - 1];
+			scores[j] = scores[j - 1];
+		}
+
+		log.moves[j] = move;
+		scores[j] = score;
+	}
+}
+
+void updateHistory(SearchThread& thread, Move move, int ply, int depth, const Move* quiets, int quietCount)
+{
+	const Position& pos = thread.board;
+	if (thread.killers[ply][0] != move)
+	{
+		thread.killers[ply][1] = thread.killers[ply][0];
+		thread.killers[ply][0] = move;
+	}
+
+	Move previous = thread.plyMoves[ply];
+	if (previous != NO_MOVE)
+	{
+		thread.counterMoves[pos.squares[moveTo(previous)]][moveTo(previous)] = move;
+	}
+
+	//cutoffs deep in the tree say more than those near the leaves. Each change is scaled down as the
+	//score nears its limit, so the scores never leave their range and old results fade as new ones arrive
+	int bonus = depth * depth;
+	auto adjust = [&](Move quiet, int change)
+	{
+		int& score = thread.history[pos.side][moveFrom(quiet)][moveTo(quiet)];
+		score += change - score * std::abs(change) / HISTORY_MAX;
+	};
+	adjust(move, bonus);
+	for (int k = 0; k < quietCount; k++)
+	{
+		adjust(quiets[k], -bonus);
+	}
+}
+
+void initReductions()
+{
+	//reductions grow with the logarithms of both the depth left and how late the move comes
+	for (int depth = 1; depth < 64; depth++)
+		for (int number = 1; number < 64; number++)
+		{
+			lateReductions[depth][number] = (int)(0.75 + std::log(depth) * std::log(number) / 2.25);
+		}
+}
+
+bool parseSelectivity(const std::string& text, int& selectivity)
+{
+	if (text == "all" || text == "none")
+	{
+		selectivity = text == "all" ? ALL_SELECTIVITY : 0;
+		return true;
+	}
+
+	int flags = 0;
+	std::istringstream stream(text);
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		const char* const* name = std::find(selectivityNames, selectivityNames + 5, item);
+		if (name == selectivityNames + 5)
+		{
+			return false;
+		}
+		flags |= 1 << (name - selectivityNames);
+	}
+
+	selectivity = flags;
+	return true;
+}
+
+void orderHashMove(MoveList& log, Move move)
+{
+	if (move == NO_MOVE)
+	{
+		return;
+	}
+
+	for (int i = 0; i < log.size; i++)
+	{
+		if (log.moves[i] == move)
+		{
+			//swap the hash move to the front of the log
+			std::swap(log.moves[0], log.moves[i]);
+			return;
+		}
+	}
+}
+
+void resizeHash(HashTable& table, int megabytes)
+{
+	//use the largest power of two number of buckets that fits, so a key maps to a bucket with a mask
+	table.size = 1;
+	while (table.size * 2 * sizeof(HashBucket) <= (size_t)megabytes * 1024 * 1024)
+	{
+		table.size *= 2;
+	}
+
+	table.buckets.reset(new HashBucket[table.size]);
+	clearHash(table);
+}
+
+void clearHash(HashTable& table)
+{
+	for (size_t b = 0; b < table.size; b++)
+		for (int k = 0; k < 4; k++)
+		{
+			table.buckets[b].slots[k].check.store(0, std::memory_order_relaxed);
+			table.buckets[b].slots[k].data.store(0, std::memory_order_relaxed);
+		}
+
+	table.generation = 0;
+}
+
+unsigned long long packEntry(int depth, int bound, int score, Move move, unsigned char generation)
+{
+	return (unsigned long long)(unsigned short)score
+		| (unsigned long long)depth << 16
+		| (unsigned long long)bound << 24
+		| (unsigned long long)move << 32
+		| (unsigned long long)generation << 48;
+}
+
+HashEntry unpackEntry(Key key, unsigned long long data)
+{
+	HashEntry entry;
+	entry.key = key;
+	entry.score = (short)(data & 0xFFFF);
+	entry.depth = (unsigned char)(data >> 16);
+	entry.bound = (unsigned char)(data >> 24);
+	entry.move = (Move)(data >> 32);
+	entry.generation = (unsigned char)(data >> 48);
+	return entry;
+}
+
+bool probeHash(const HashTable& table, Key key, HashEntry& entry)
+{
+	HashBucket& bucket = table.buckets[key & (table.size - 1)];
+
+	for (int k = 0; k < 4; k++)
+	{
+		unsigned long long data = bucket.slots[k].data.load(std::memory_order_relaxed);
+		Key check = bucket.slots[k].check.load(std::memory_order_relaxed);
+
+		if ((check ^ data) == key && data != 0)
+		{
+			entry = unpackEntry(key, data);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void storeHash(HashTable& table, Key key, int depth, int bound, int score, Move move)
+{
+	HashBucket& bucket = table.buckets[key & (table.size - 1)];
+	unsigned char generation = table.generation;
+
+	//overwrite the same position if present, otherwise the shallowest entry from the oldest search
+	int replace = 0;
+	HashEntry replaceEntry;
+	for (int k = 0; k < 4; k++)
+	{
+		unsigned long long data = bucket.slots[k].data.load(std::memory_order_relaxed);
+		Key slotKey = bucket.slots[k].check.load(std::memory_order_relaxed) ^ data;
+		HashEntry entry = unpackEntry(slotKey, data);
+
+		if (slotKey == key)
+		{
+			replace = k;
+			replaceEntry = entry;
+			break;
+		}
+
+		int age = (unsigned char)(generation - entry.generation);
+		int replaceAge = (unsigned char)(generation - replaceEntry.generation);
+		if (k == 0 || entry.depth - 8 * age < replaceEntry.depth - 8 * replaceAge)
+		{
+			replace = k;
+			replaceEntry = entry;
+		}
+	}
+
+	//keep the old best move when this search failed low and found none
+	if (move == NO_MOVE && replaceEntry.key == key)
+	{
+		move = replaceEntry.move;
+	}
+
+	unsigned long long data = packEntry(depth, bound, score, move, generation);
+	bucket.slots[replace].check.store(key ^ data, std::memory_order_relaxed);
+	bucket.slots[replace].data.store(data, std::memory_order_relaxed);
+}
+
+int scoreToHash(int score, int ply)
+{
+	//mates are stored as the distance from this position rather than from the root, so they stay right when met again at another ply
+	if (score >= MATE_BOUND)
+	{
+		return score + ply;
+	}
+	if (score <= -MATE_BOUND)
+	{
+		return score - ply;
+	}
+	return score;
+}
+
+int scoreFromHash(int score, int ply)
+{
+	if (score >= MATE_BOUND)
+	{
+		return score - ply;
+	}
+	if (score <= -MATE_BOUND)
+	{
+		return score + ply;
+	}
+	return score;
+}
+
+int hashFull(const HashTable& table)
+{
+	//sample the first thousand entries and return how many are in use, per mille
+	int used = 0;
+	int sampled = 0;
+	for (size_t b = 0; b < table.size && sampled < 1000; b++)
+		for (int k = 0; k < 4 && sampled < 1000; k++, sampled++)
+		{
+			if (table.buckets[b].slots[k].data.load(std::memory_order_relaxed) != 0)
+			{
+				used++;
+			}
+		}
+
+	return sampled == 0 ? 0 : used * 1000 / sampled;
+}
+
+bool inCheck(const Position& pos)
+{
+	int king = pos.kingSquares[pos.side];
+	return king != NO_SQUARE && squareAttacked(pos, king, pos.side ^ 1);
+}
+
+bool squareAttacked(const Position& pos, int square, int bySide)
+{
+	//look outwards from the square for each kind of attacker, as a piece there of that kind would see them
+
+	//check pawn attacks
+	if (pawnAttacks[bySide ^ 1][square] & pos.pieces[makePiece(PAWN, bySide)])
+	{
+		return true;
+	}
+
+	//check knights attacks
+	if (knightAttacks[square] & pos.pieces[makePiece(KNIGHT, bySide)])
+	{
+		return true;
+	}
+
+	//check rook/lateral queen attacks
+	Bitboard queens = pos.pieces[makePiece(QUEEN, bySide)];
+	if (rookAttacks(square, pos.occupied) & (pos.pieces[makePiece(ROOK, bySide)] | queens))
+	{
+		return true;
+	}
+
+	//check bishop/diagonal queen attacks
+	if (bishopAttacks(square, pos.occupied) & (pos.pieces[makePiece(BISHOP, bySide)] | queens))
+	{
+		return true;
+	}
+
+	//check king moves
+	return (kingAttacks[square] & pos.pieces[makePiece(KING, bySide)]) != 0;
+}
+
+Bitboard attackersTo(const Position& pos, int square, Bitboard occupied)
+{
+	Bitboard queens = pos.pieces[makePiece(QUEEN, WHITE)] | pos.pieces[makePiece(QUEEN, BLACK)];
+
+	return (pawnAttacks[BLACK][square] & pos.pieces[makePiece(PAWN, WHITE)])
+		| (pawnAttacks[WHITE][square] & pos.pieces[makePiece(PAWN, BLACK)])
+		| (knightAttacks[square] & (pos.pieces[makePiece(KNIGHT, WHITE)] | pos.pieces[makePiece(KNIGHT, BLACK)]))
+		| (rookAttacks(square, occupied) & (pos.pieces[makePiece(ROOK, WHITE)] | pos.pieces[makePiece(ROOK, BLACK)] | queens))
+		| (bishopAttacks(square, occupied) & (pos.pieces[makePiece(BISHOP, WHITE)] | pos.pieces[makePiece(BISHOP, BLACK)] | queens))
+		| (kingAttacks[square] & (pos.pieces[makePiece(KING, WHITE)] | pos.pieces[makePiece(KING, BLACK)]));
+}
+
+int see(const Position& pos, Move move)
+{
+	//each side in turn takes with its least valuable piece, and may stop rather than take when that
+	//would lose. x-ray attackers join as the pieces in front of them leave the board
+	int from = moveFrom(move);
+	int to = moveTo(move);
+	int side = pos.side;
+	int captured = moveFlags(move) == EN_PASSANT ? makePiece(PAWN, side ^ 1) : pos.squares[to];
+	int promotion = promotionType(move) ? makePiece(promotionType(move), side) : 0;
+	Bitboard occupied = pos.occupied ^ (1ULL << from);
+	if (moveFlags(move) == EN_PASSANT)
+	{
+		occupied ^= 1ULL << ((from & 56) | (to & 7));
+	}
+
+	//gains[d] is the material won by the side making the d-th capture if the exchange ended there
+	int gains[32];
+	int depth = 0;
+	gains[0] = pieceValues[captured] + (promotion ? pieceValues[promotion] - 100 : 0);
+	int onSquare = pieceValues[promotion ? promotion : pos.squares[from]];
+
+	Bitboard attackers = attackersTo(pos, to, occupied) & occupied;
+	while (depth < 31)
+	{
+		side ^= 1;
+		Bitboard own = attackers & pos.sides[side];
+		if (!own)
+		{
+			break;
+		}
+
+		int type = PAWN;
+		for (int t : { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING })
+		{
+			if (own & pos.pieces[makePiece(t, side)])
+			{
+				type = t;
+				break;
+			}
+		}
+
+		//the king may only take when nothing can take it back
+		if (type == KING && (attackers & pos.sides[side ^ 1]))
+		{
+			break;
+		}
+
+		depth++;
+		gains[depth] = onSquare - gains[depth - 1];
+		onSquare = pieceValues[makePiece(type, side)];
+		occupied ^= 1ULL << lsb(own & pos.pieces[makePiece(type, side)]);
+		attackers = attackersTo(pos, to, occupied) & occupied;
+	}
+
+	//from the last capture back, each side only takes if it does better than stopping
+	for (; depth > 0; depth--)
+	{
+		gains[depth - 1] = -std::max(-gains[depth - 1], gains[depth]);
+	}
+
+	return gains[0];
+}
+
+void initEvaluation()
+{
+	//the tables are written from white's side with rank 8 first, so white reads them mirrored
+	for (int piece = 1; piece <= 12; piece++)
+		for (int square = 0; square < 64; square++)
+		{
+			int type = pieceType(piece);
+			int index = pieceSide(piece) == WHITE ? square ^ 56 : square;
+			mgPieceSquare[piece][square] = mgMaterial[type] + mgSquares[type][index];
+			egPieceSquare[piece][square] = egMaterial[type] + egSquares[type][index];
+		}
+}
+
+int evaluate(const Position& pos)
+{
+	if (useNetwork)
+	{
+		return evaluateNetwork(pos);
+	}
+
+	//material and piece-square sums are kept up to date move by move, so only the attack terms are worked out here
+	int mg = pos.mg[WHITE] - pos.mg[BLACK];
+	int eg = pos.eg[WHITE] - pos.eg[BLACK];
+
+	for (int side = WHITE; side <= BLACK; side++)
+	{
+		int sign = side == WHITE ? 1 : -1;
+		Bitboard enemyPawns = pos.pieces[makePiece(PAWN, side ^ 1)];
+		Bitboard enemyPawnAttacks = side == WHITE
+			? ((enemyPawns >> 7) & ~0x0101010101010101ULL) | ((enemyPawns >> 9) & ~0x8080808080808080ULL)
+			: ((enemyPawns << 7) & ~0x8080808080808080ULL) | ((enemyPawns << 9) & ~0x0101010101010101ULL);
+		Bitboard safe = ~pos.sides[side] & ~enemyPawnAttacks; //squares a piece could go without being taken by a pawn
+		int enemyKing = pos.kingSquares[side ^ 1];
+		Bitboard kingZone = enemyKing != NO_SQUARE ? kingAttacks[enemyKing] | 1ULL << enemyKing : 0;
+		int attackers = 0;
+		int attackWeight = 0;
+
+		//mobility counts safe squares against a typical count for the piece; attacks on the squares
+		//around the enemy king add to the danger it is in
+		for (int type = ROOK; type <= QUEEN; type++)
+		{
+			Bitboard pieces = pos.pieces[makePiece(type, side)];
+			while (pieces)
+			{
+				int square = popLsb(pieces);
+				Bitboard attacks = type == KNIGHT ? knightAttacks[square]
+					: type == BISHOP ? bishopAttacks(square, pos.occupied)
+					: type == ROOK ? rookAttacks(square, pos.occupied)
+					: rookAttacks(square, pos.occupied) | bishopAttacks(square, pos.occupied);
+				int mobility = popCount(attacks & safe);
+
+				switch (type)
+				{
+					case KNIGHT: mg += sign * 4 * (mobility - 4);
+						eg += sign * 4 * (mobility - 4);
+						break;
+					case BISHOP: mg += sign * 5 * (mobility - 6);
+						eg += sign * 5 * (mobility - 6);
+						break;
+					case ROOK: mg += sign * 2 * (mobility - 7);
+						eg += sign * 4 * (mobility - 7);
+						break;
+					case QUEEN: mg += sign * (mobility - 13);
+						eg += sign * 2 * (mobility - 13);
+						break;
 				}
-				if (i + 1 <= 7)
+
+				if (attacks & kingZone)
 				{
-					if (j + 2 <= 7)
-					{
-						if (board[i + 1][j + 2] == 6)
-						{
-							return true;
-						}
-					}
-					if (j - 2 >= 0)
-					{
-						if (board[i + 1][j - 2] == 6)
-						{
-							return true;
-						}
-					}
+					attackers++;
+					attackWeight += type == QUEEN ? 5 : type == ROOK ? 3 : 2;
 				}
-				if (i - 1 >= 0)
+			}
+		}
+
+		//a lone attacker is rarely dangerous, several together grow quickly more so; without a queen to
+		//lead it an attack seldom comes to anything, so only a side with one scores the term
+		if (attackers >= 2 && pos.pieces[makePiece(QUEEN, side)])
+		{
+			mg += sign * std::min(attackWeight * attackWeight, 200);
+		}
+	}
+
+	int phase = std::min(pos.phase, 24);
+	int score = (mg * phase + eg * (24 - phase)) / 24;
+	return pos.side == WHITE ? score : -score;
+}
+
+bool loadNetwork(const std::string& path)
+{
+	//little-endian 16 bit values in the order of the struct; any padding after the last is ignored
+	std::ifstream file(path, std::ios::binary);
+	file.read((char*)network.featureWeights, sizeof(network.featureWeights));
+	file.read((char*)network.featureBias, sizeof(network.featureBias));
+	file.read((char*)network.outputWeights, sizeof(network.outputWeights));
+	file.read((char*)&network.outputBias, sizeof(network.outputBias));
+	return (bool)file;
+}
+
+void randomNetwork()
+{
+	//small weights from a fixed seed, only good for timing
+	Key state = 88172645463325252ULL;
+	auto weight = [&]()
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return (int16_t)((int)(state % 64) - 32);
+	};
+
+	for (int input = 0; input < NNUE_INPUTS; input++)
+		for (int k = 0; k < NNUE_HIDDEN; k++)
+		{
+			network.featureWeights[input][k] = weight();
+		}
+	for (int k = 0; k < NNUE_HIDDEN; k++)
+	{
+		network.featureBias[k] = weight();
+	}
+	for (int k = 0; k < 2 * NNUE_HIDDEN; k++)
+	{
+		network.outputWeights[k] = weight();
+	}
+	network.outputBias = weight();
+}
+
+int networkInput(int piece, int square, int view)
+{
+	//each side sees its own pieces first and the board from its own end, so the network need only learn one point of view
+	int side = pieceSide(piece);
+	return (side == view ? 0 : 384) + 64 * networkTypes[pieceType(piece)] + (view == WHITE ? square : square ^ 56);
+}
+
+void addFeature(Position& pos, int piece, int square)
+{
+	accumulatorAdd(pos.accumulator[WHITE], network.featureWeights[networkInput(piece, square, WHITE)]);
+	accumulatorAdd(pos.accumulator[BLACK], network.featureWeights[networkInput(piece, square, BLACK)]);
+}
+
+void removeFeature(Position& pos, int piece, int square)
+{
+	accumulatorSub(pos.accumulator[WHITE], network.featureWeights[networkInput(piece, square, WHITE)]);
+	accumulatorSub(pos.accumulator[BLACK], network.featureWeights[networkInput(piece, square, BLACK)]);
+}
+
+int evaluateNetwork(const Position& pos)
+{
+	//the accumulators are kept up to date move by move, so only the output layer is worked out here
+	int output = network.outputBias
+		+ outputDot(pos.accumulator[pos.side], network.outputWeights)
+		+ outputDot(pos.accumulator[pos.side ^ 1], network.outputWeights + NNUE_HIDDEN);
+	int score = (int)((long long)output * NNUE_SCALE / (NNUE_QA * NNUE_QB));
+
+	//kept clear of the mate scores
+	return std::max(-MATE_BOUND + 1, std::min(score, MATE_BOUND - 1));
+}
+
+int bestKernel()
+{
+#if defined(SIMD_BUILD) && defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	bool sse41 = (info[2] & (1 << 19)) != 0;
+	bool avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6; //the system saves the ymm registers
+	__cpuidex(info, 7, 0);
+	bool avx2 = avx && (info[1] & (1 << 5)) != 0;
+	return avx2 ? KERNEL_AVX2 : sse41 ? KERNEL_SSE41 : KERNEL_SCALAR;
+#elif defined(SIMD_BUILD)
+	return __builtin_cpu_supports("avx2") ? KERNEL_AVX2 : __builtin_cpu_supports("sse4.1") ? KERNEL_SSE41 : KERNEL_SCALAR;
+#else
+	return KERNEL_SCALAR;
+#endif
+}
+
+#if defined(SIMD_BUILD)
+//each kernel is compiled for its own instruction set, so the build itself need not target one
+TARGET("avx2") void accumulatorAddAvx2(int16_t* accumulator, const int16_t* column, bool add)
+{
+	for (int k = 0; k < NNUE_HIDDEN; k += 16)
+	{
+		__m256i values = _mm256_load_si256((const __m256i*)(accumulator + k));
+		__m256i weights = _mm256_load_si256((const __m256i*)(column + k));
+		values = add ? _mm256_add_epi16(values, weights) : _mm256_sub_epi16(values, weights);
+		_mm256_store_si256((__m256i*)(accumulator + k), values);
+	}
+}
+
+TARGET("avx2") int outputDotAvx2(const int16_t* accumulator, const int16_t* weights)
+{
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ceiling = _mm256_set1_epi16(NNUE_QA);
+	__m256i sum = _mm256_setzero_si256();
+
+	for (int k = 0; k < NNUE_HIDDEN; k += 16)
+	{
+		//the bias is added with saturation, which clips to the same value as the scalar sum would
+		__m256i values = _mm256_adds_epi16(_mm256_load_si256((const __m256i*)(accumulator + k)), _mm256_load_si256((const __m256i*)(network.featureBias + k)));
+		values = _mm256_min_epi16(_mm256_max_epi16(values, zero), ceiling);
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(values, _mm256_load_si256((const __m256i*)(weights + k))));
+	}
+
+	__m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	half = _mm_hadd_epi32(half, half);
+	half = _mm_hadd_epi32(half, half);
+	return _mm_cvtsi128_si32(half);
+}
+
+TARGET("sse4.1") void accumulatorAddSse41(int16_t* accumulator, const int16_t* column, bool add)
+{
+	for (int k = 0; k < NNUE_HIDDEN; k += 8)
+	{
+		__m128i values = _mm_load_si128((const __m128i*)(accumulator + k));
+		__m128i weights = _mm_load_si128((const __m128i*)(column + k));
+		values = add ? _mm_add_epi16(values, weights) : _mm_sub_epi16(values, weights);
+		_mm_store_si128((__m128i*)(accumulator + k), values);
+	}
+}
+
+TARGET("sse4.1") int outputDotSse41(const int16_t* accumulator, const int16_t* weights)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ceiling = _mm_set1_epi16(NNUE_QA);
+	__m128i sum = _mm_setzero_si128();
+
+	for (int k = 0; k < NNUE_HIDDEN; k += 8)
+	{
+		__m128i values = _mm_adds_epi16(_mm_load_si128((const __m128i*)(accumulator + k)), _mm_load_si128((const __m128i*)(network.featureBias + k)));
+		values = _mm_min_epi16(_mm_max_epi16(values, zero), ceiling);
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(values, _mm_load_si128((const __m128i*)(weights + k))));
+	}
+
+	return _mm_extract_epi32(sum, 0) + _mm_extract_epi32(sum, 1) + _mm_extract_epi32(sum, 2) + _mm_extract_epi32(sum, 3);
+}
+#endif
+
+void accumulatorAdd(int16_t* accumulator, const int16_t* column)
+{
+	switch (networkKernel)
+	{
+#if defined(SIMD_BUILD)
+		case KERNEL_AVX2: accumulatorAddAvx2(accumulator, column, true);
+			return;
+		case KERNEL_SSE41: accumulatorAddSse41(accumulator, column, true);
+			return;
+#endif
+		default:
+			for (int k = 0; k < NNUE_HIDDEN; k++)
+			{
+				accumulator[k] += column[k];
+			}
+	}
+}
+
+void accumulatorSub(int16_t* accumulator, const int16_t* column)
+{
+	switch (networkKernel)
+	{
+#if defined(SIMD_BUILD)
+		case KERNEL_AVX2: accumulatorAddAvx2(accumulator, column, false);
+			return;
+		case KERNEL_SSE41: accumulatorAddSse41(accumulator, column, false);
+			return;
+#endif
+		default:
+			for (int k = 0; k < NNUE_HIDDEN; k++)
+			{
+				accumulator[k] -= column[k];
+			}
+	}
+}
+
+int outputDot(const int16_t* accumulator, const int16_t* weights)
+{
+	switch (networkKernel)
+	{
+#if defined(SIMD_BUILD)
+		case KERNEL_AVX2: return outputDotAvx2(accumulator, weights);
+		case KERNEL_SSE41: return outputDotSse41(accumulator, weights);
+#endif
+		default:
+			int sum = 0;
+			for (int k = 0; k < NNUE_HIDDEN; k++)
+			{
+				int value = std::max(0, std::min(accumulator[k] + network.featureBias[k], NNUE_QA));
+				sum += value * weights[k];
+			}
+			return sum;
+	}
+}
+
+void evalBenchmark(const std::string& path)
+{
+	if (path.empty())
+	{
+		std::cout << "No network given, timing random weights" << std::endl;
+		randomNetwork();
+	}
+	else if (!loadNetwork(path))
+	{
+		std::cout << "Could not load the network from " << path << std::endl;
+		return;
+	}
+
+	std::cout << std::setw(14) << "Evaluator" << std::setw(14) << "Evals" << std::setw(14) << "Evals/sec" << std::setw(10) << "ns/eval"
+		<< std::setw(14) << "Checksum" << std::endl;
+
+	//every move of the test positions is made, evaluated and taken back for about a second, so the network's
+	//times include keeping its accumulators up to date; the checksum of one pass shows the kernels agree
+	int fastest = bestKernel();
+	for (int row = -1; row <= fastest; row++)
+	{
+		useNetwork = row >= 0;
+		networkKernel = std::max(row, 0);
+
+		std::vector<Position> positions;
+		for (const PerftPosition& test : perftPositions)
+		{
+			positions.push_back(Position());
+			setFen(positions.back(), test.fen);
+		}
+
+		long long evals = 0;
+		long long checksum = 0;
+		long long time = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int pass = 0; time < 1000; pass++)
+		{
+			for (Position& pos : positions)
+			{
+				MoveList log;
+				logMoves(pos, log);
+				for (int k = 0; k < log.size; k++)
 				{
-					if (j + 2 <= 7)
-					{
-						if (board[i - 1][j + 2] == 6)
-						{
-							return true;
-						}
-					}
-					if (j - 2 >= 0)
-					{
-						if (board[i - 1][j - 2] == 6)
-						{
-							return true;
-						}
-					}
+					Undo undo;
+					makeMove(pos, log.moves[k], undo);
+					int score = evaluate(pos);
+					unmakeMove(pos, log.moves[k], undo);
+
+					checksum += pass == 0 ? score : 0;
+					evals++;
 				}
+			}
+			time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		std::string name = useNetwork ? std::string("nnue ") + kernelNames[row] : "handcrafted";
+		std::cout << std::setw(14) << name << std::setw(14) << evals << std::setw(14) << evals * 1000 / std::max(1LL, time)
+			<< std::setw(10) << std::fixed << std::setprecision(1) << time * 1e6 / evals << std::setw(14) << checksum << std::endl;
+	}
+
+	useNetwork = false;
+	networkKernel = fastest;
+}
+
+void addMove(MoveList& log, Move move)
+{
+	log.moves[log.size++] = move;
+}
+
+void addPromotions(MoveList& log, int from, int to, int flags)
+{
+	//queen first, as it is nearly always the best
+	for (int k = 3; k >= 0; k--)
+	{
+		addMove(log, encodeMove(from, to, flags | PROMOTION | k));
+	}
+}
+
+void logMoves(Position& pos, MoveList& log, bool capturesOnly)
+{
+	log.size = 0;
+	int side = pos.side;
+	Bitboard own = pos.sides[side];
+	Bitboard enemies = pos.sides[side ^ 1];
+	Bitboard empty = ~pos.occupied;
+	Bitboard targets = capturesOnly ? enemies : ~own; //enemy pieces, and empty squares unless only captures are wanted
+	Bitboard lastRank = side == WHITE ? 0xFF00000000000000ULL : 0x00000000000000FFULL;
+
+	//the pieces giving check and our pieces pinned to the king are found once for the whole node,
+	//so every move can be generated legal rather than tried out and taken back
+	int king = pos.kingSquares[side];
+	Bitboard kings = king != NO_SQUARE ? 1ULL << king : 0;
+	Bitboard checkers = 0;
+	Bitboard pinned = 0;
+	Bitboard checkMask = ~0ULL; //squares the other pieces may move to: anywhere, or onto a lone checker or between it and the king
+	if (king != NO_SQUARE)
+	{
+		checkers = attackersTo(pos, king, pos.occupied) & enemies;
+		if (checkers)
+		{
+			checkMask = popCount(checkers) > 1 ? 0 : checkers | between[king][lsb(checkers)];
+		}
+
+		//an enemy slider that would see the king through exactly one of our pieces pins that piece
+		Bitboard enemyQueens = pos.pieces[makePiece(QUEEN, side ^ 1)];
+		Bitboard snipers = (rookAttacks(king, enemies) & (pos.pieces[makePiece(ROOK, side ^ 1)] | enemyQueens))
+			| (bishopAttacks(king, enemies) & (pos.pieces[makePiece(BISHOP, side ^ 1)] | enemyQueens));
+		while (snipers)
+		{
+			Bitboard blockers = between[king][popLsb(snipers)] & pos.occupied;
+			if (popCount(blockers) == 1 && (blockers & own))
+			{
+				pinned |= blockers;
+			}
+		}
+	}
+
+	//a pinned piece may still move along the line between its king and the pinning piece
+	auto legalTargets = [&](int from)
+	{
+		return pinned & (1ULL << from) ? checkMask & lineThrough[king][from] : checkMask;
+	};
+
+	//log all possible pawn moves, shifting the whole pawn set at once
+	Bitboard pawns = pos.pieces[makePiece(PAWN, side)];
+	Bitboard singles = side == WHITE ? (pawns << 8) & empty : (pawns >> 8) & empty;
+	Bitboard doubles = side == WHITE ? ((singles & 0x0000000000FF0000ULL) << 8) & empty : ((singles & 0x0000FF0000000000ULL) >> 8) & empty;
+	int forward = side == WHITE ? 8 : -8;
+	if (capturesOnly)
+	{
+		//pushes that promote are kept, as they change the material as much as a capture
+		singles &= lastRank;
+		doubles = 0;
+	}
+
+	while (doubles)
+	{
+		int to = popLsb(doubles);
+		if (legalTargets(to - 2 * forward) & (1ULL << to))
+		{
+			addMove(log, encodeMove(to - 2 * forward, to, DOUBLE_PUSH));
+		}
+	}
+	while (singles)
+	{
+		int to = popLsb(singles);
+		if (!(legalTargets(to - forward) & (1ULL << to)))
+		{
+			continue;
+		}
+
+		if ((1ULL << to) & lastRank)
+		{
+			addPromotions(log, to - forward, to, QUIET);
+		}
+		else
+		{
+			addMove(log, encodeMove(to - forward, to, QUIET));
+		}
+	}
+	while (pawns)
+	{
+		int from = popLsb(pawns);
+		Bitboard captures = pawnAttacks[side][from] & enemies & legalTargets(from);
+
+		while (captures)
+		{
+			int to = popLsb(captures);
+			if ((1ULL << to) & lastRank)
+			{
+				addPromotions(log, from, to, CAPTURE);
+			}
+			else
+			{
+				addMove(log, encodeMove(from, to, CAPTURE));
+			}
+		}
+
+		//the pawn taken en passant is not on the square moved to, so instead of the masks the king is
+		//tested directly against the occupancy after the capture, which also catches the rare pin along a rank
+		if (pos.epSquare != NO_SQUARE && (pawnAttacks[side][from] & (1ULL << pos.epSquare)))
+		{
+			int captured = pos.epSquare - forward;
+			Bitboard occupied = (pos.occupied ^ (1ULL << from) ^ (1ULL << captured)) | (1ULL << pos.epSquare);
+			if (king == NO_SQUARE || !(attackersTo(pos, king, occupied) & enemies & ~(1ULL << captured)))
+			{
+				addMove(log, encodeMove(from, pos.epSquare, EN_PASSANT));
+			}
+		}
+	}
+
+	//log all possible rook/queen moves
+	Bitboard queens = pos.pieces[makePiece(QUEEN, side)];
+	Bitboard rooks = pos.pieces[makePiece(ROOK, side)] | queens;
+	while (rooks)
+	{
+		int from = popLsb(rooks);
+		Bitboard moves = rookAttacks(from, pos.occupied) & targets & legalTargets(from);
+
+		while (moves)
+		{
+			int to = popLsb(moves);
+			addMove(log, encodeMove(from, to, pos.squares[to] != 0 ? CAPTURE : QUIET));
+		}
+	}
+
+	//log all possible knight moves
+	Bitboard knights = pos.pieces[makePiece(KNIGHT, side)];
+	while (knights)
+	{
+		int from = popLsb(knights);
+		Bitboard moves = knightAttacks[from] & targets & legalTargets(from);
+
+		while (moves)
+		{
+			int to = popLsb(moves);
+			addMove(log, encodeMove(from, to, pos.squares[to] != 0 ? CAPTURE : QUIET));
+		}
+	}
+
+	//log all possible bishop moves
+	Bitboard bishops = pos.pieces[makePiece(BISHOP, side)] | queens;
+	while (bishops)
+	{
+		int from = popLsb(bishops);
+		Bitboard moves = bishopAttacks(from, pos.occupied) & targets & legalTargets(from);
+
+		while (moves)
+		{
+			int to = popLsb(moves);
+			addMove(log, encodeMove(from, to, pos.squares[to] != 0 ? CAPTURE : QUIET));
+		}
+	}
+
+	//log all possible king moves, to squares that would not be attacked once the king has left its own
+	if (king != NO_SQUARE)
+	{
+		Bitboard moves = kingAttacks[king] & targets;
+
+		while (moves)
+		{
+			int to = popLsb(moves);
+			if (!(attackersTo(pos, to, pos.occupied ^ kings) & enemies))
+			{
+				addMove(log, encodeMove(king, to, pos.squares[to] != 0 ? CAPTURE : QUIET));
+			}
+		}
+	}
 
-				//check rook/lateral queen attacks
-				for (int k = i + 1; k <= 7; k++)
-				{
-					if (board[k][j] % 2 == 1)
-					{
-						break;
-					}
-					else if (board[k][j] == 4 || board[k][j] == 10)
-					{
-						return true;
-					}
-				}
-				for (int k = i - 1; k >= 0; k--)
-				{
-					if (board[k][j] % 2 == 1)
-					{
-						break;
-					}
-					else if (board[k][j] == 4 || board[k][j] == 10)
-					{
-						return true;
-					}
-				}
-				for (int k = j + 1; k <= 7; k++)
-				{
-					if (board[i][k] % 2 == 1)
-					{
-						break;
-					}
-					else if (board[i][k] == 4 || board[i][k] == 10)
-					{
-						return true;
-					}
-				}
-				for (int k = j - 1; k >= 0; k--)
-				{
-					if (board[i][k] % 2 == 1)
-					{
-						break;
-					}
-					else if (board[i][k] == 4 || board[i][k] == 10)
-					{
-						return true;
-					}
-				}
+	//log castling, which needs the squares between king and rook empty and may not start in, pass through or end in check
+	if (king != NO_SQUARE && !checkers && !capturesOnly)
+	{
+		int home = side == WHITE ? 0 : 56;
+		int kingside = side == WHITE ? WHITE_KINGSIDE : BLACK_KINGSIDE;
+		int queenside = side == WHITE ? WHITE_QUEENSIDE : BLACK_QUEENSIDE;
+		Bitboard rooks = pos.pieces[makePiece(ROOK, side)];
 
-				//check bishop/diagonal queen attacks
-				for (int k = 1; k <= 7; k++)
-				{
-					if (i + k <= 7)
-					{
-						if (j + k <= 7)
-						{
-							if (board[i + k][j + k] % 2 == 1)
-							{
-								break;
-							}
-							else if (board[i + k][j + k] == 8 || board[i + k][j + k] == 10)
-							{
-								return true;
-							}
-						}
-					}
-				}
-				for (int k = 1; k <= 7; k++)
-				{
-					if (i + k <= 7)
-					{
-						if (j - k >= 0)
-						{
-							if (board[i + k][j - k] % 2 == 1)
-							{
-								break;
-							}
-							else if (board[i + k][j - k] == 8 || board[i + k][j - k] == 10)
-							{
-								return true;
-							}
-						}
-					}
-				}
-				for (int k = 1; k <= 7; k++)
-				{
-					if (i - k >= 0)
-					{
-						if (j + k <= 7)
-						{
-							if (board[i - k][j + k] % 2 == 1)
-							{
-								break;
-							}
-							else if (board[i - k][j + k] == 8 || board[i - k][j + k] == 10)
-							{
-								return true;
-							}
-						}
-					}
-				}
-				for (int k = 1; k <= 7; k++)
-				{
-					if (i - k >= 0)
-					{
-						if (j - k >= 0)
-						{
-							if (board[i - k][j - k] % 2 == 1)
-							{
-								break;
-							}
-							else if (board[i - k][j - k] == 8 || board[i - k][j - k] == 10)
-							{
-								return true;
-							}
-						}
-					}
-				}
+		if ((pos.castling & kingside) && (rooks & (1ULL << (home + 7))) && !(pos.occupied & (0x60ULL << home))
+			&& !squareAttacked(pos, home + 5, side ^ 1) && !squareAttacked(pos, home + 6, side ^ 1))
+		{
+			addMove(log, encodeMove(home + 4, home + 6, KING_CASTLE));
+		}
+		if ((pos.castling & queenside) && (rooks & (1ULL << home)) && !(pos.occupied & (0x0EULL << home))
+			&& !squareAttacked(pos, home + 3, side ^ 1) && !squareAttacked(pos, home + 2, side ^ 1))
+		{
+			addMove(log, encodeMove(home + 4, home + 2, QUEEN_CASTLE));
+		}
+	}
+}
+
+long long perft(Position& pos, int depth)
+{
+	MoveList log;
+	logMoves(pos, log);
+
+	//bulk counting: every move of the last ply is a leaf, so there is no need to make them
+	if (depth == 1)
+	{
+		return log.size;
+	}
+
+	//transposed subtrees are counted once when the perft table is enabled
+	Key key = pos.key;
+	HashSlot* slot = nullptr;
+	if (perftSlots != 0)
+	{
+		slot = &perftTable[(key ^ (Key)depth * 0x9E3779B97F4A7C15ULL) & (perftSlots - 1)];
+		unsigned long long data = slot->data.load(std::memory_order_relaxed);
+		if ((slot->check.load(std::memory_order_relaxed) ^ data) == key && (int)(data & 0xFF) == depth)
+		{
+			return (long long)(data >> 8);
+		}
+	}
+
+	long long nodes = 0;
+	for (int i = 0; i < log.size; i++)
+	{
+		Undo undo;
+		makeMove(pos, log.moves[i], undo);
+		nodes += perft(pos, depth - 1);
+		unmakeMove(pos, log.moves[i], undo);
+	}
+
+	if (slot != nullptr)
+	{
+		unsigned long long data = (unsigned long long)nodes << 8 | (unsigned long long)depth;
+		slot->check.store(key ^ data, std::memory_order_relaxed);
+		slot->data.store(data, std::memory_order_relaxed);
+	}
+
+	return nodes;
+}
+
+void perftDivide(const Position& pos, int depth, std::vector<long long>& counts, MoveList& rootLog)
+{
+	Position root = pos;
+	logMoves(root, rootLog);
+	counts.assign(rootLog.size, depth == 1 ? 1 : 0);
+	if (depth == 1)
+	{
+		return;
+	}
+
+	if (PERFT_HASH_MB > 0 && perftSlots == 0)
+	{
+		perftSlots = 1;
+		while (perftSlots * 2 * sizeof(HashSlot) <= (size_t)PERFT_HASH_MB * 1024 * 1024)
+		{
+			perftSlots *= 2;
+		}
+		perftTable.reset(new HashSlot[perftSlots]);
+		for (size_t k = 0; k < perftSlots; k++)
+		{
+			perftTable[k].check.store(0, std::memory_order_relaxed);
+			perftTable[k].data.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	//split the root moves between the threads, each taking the next unclaimed move
+	std::atomic<int> nextMove(0);
+	auto worker = [&]()
+	{
+		Position board = pos;
+
+		for (int k = nextMove++; k < (int)counts.size(); k = nextMove++)
+		{
+			Undo undo;
+			makeMove(board, rootLog.moves[k], undo);
+			counts[k] = perft(board, depth - 1);
+			unmakeMove(board, rootLog.moves[k], undo);
+		}
+	};
+
+	std::vector<std::thread> helpers;
+	for (int t = 1; t < THREADS; t++)
+	{
+		helpers.emplace_back(worker);
+	}
+	worker();
+	for (std::thread& helper : helpers)
+	{
+		helper.join();
+	}
+}
+
+void perftCommand(int depth, const std::string& fen)
+{
+	Position pos;
+	if (!setFen(pos, fen))
+	{
+		std::cout << "Invalid FEN: " << fen << std::endl;
+		return;
+	}
+
+	std::vector<long long> counts;
+	MoveList rootLog;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	perftDivide(pos, depth, counts, rootLog);
+	long long time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+	//divide: the leaf count below each root move, to narrow a wrong total down to a single move
+	long long nodes = 0;
+	for (int k = 0; k < (int)counts.size(); k++)
+	{
+		std::cout << moveText(rootLog.moves[k]) << ": " << counts[k] << std::endl;
+		nodes += counts[k];
+	}
+
+	std::cout << std::endl << "Nodes: " << nodes << std::endl
+		<< "Time: " << time << " ms" << std::endl
+		<< "NPS: " << nodes * 1000 / std::max(1LL, time) << std::endl;
+}
+
+void perftSuite(int depth)
+{
+	std::cout << std::left << std::setw(12) << "Position" << std::right << std::setw(7) << "Depth" << std::setw(14) << "Nodes"
+		<< std::setw(14) << "Expected" << std::setw(12) << "NPS" << std::endl;
+
+	long long totalNodes = 0;
+	long long totalTime = 0;
+	for (const PerftPosition& test : perftPositions)
+	{
+		//positions without a known count at this depth are run at their deepest known one
+		int testDepth = std::min(depth, 6);
+		while (testDepth > 1 && test.expected[testDepth - 1] == 0)
+		{
+			testDepth--;
+		}
+
+		Position pos;
+		setFen(pos, test.fen);
+
+		std::vector<long long> counts;
+		MoveList rootLog;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		perftDivide(pos, testDepth, counts, rootLog);
+		long long time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+		long long nodes = 0;
+		for (long long count : counts)
+		{
+			nodes += count;
+		}
+		totalNodes += nodes;
+		totalTime += time;
+
+		long long expected = test.expected[testDepth - 1];
+		std::cout << std::left << std::setw(12) << test.name << std::right << std::setw(7) << testDepth << std::setw(14) << nodes
+			<< std::setw(14) << expected << std::setw(12) << nodes * 1000 / std::max(1LL, time)
+			<< (nodes == expected ? "" : "  MISMATCH") << std::endl;
+	}
+
+	std::cout << std::endl << "Total nodes: " << totalNodes << std::endl
+		<< "Total time: " << totalTime << " ms" << std::endl
+		<< "NPS: " << totalNodes * 1000 / std::max(1LL, totalTime) << std::endl;
+}
+
+void benchCommand(int depth)
+{
+	//one thread and a cleared table of the default size for every position, so the node count depends on
+	//nothing but the search itself and changes only when the search does
+	int threads = THREADS;
+	int men = tablebaseMen;
+	THREADS = 1;
+	tablebaseMen = 0;
+	resizeHash(hashTable, 16);
+	SearchLimits benchLimits;
+	benchLimits.depth = depth;
+	benchLimits.moveTime = 0;
+
+	std::cout << std::setw(8) << "Position" << std::setw(14) << "Nodes" << std::setw(10) << "ms" << std::setw(8) << "Move" << std::endl;
+
+	long long totalNodes = 0;
+	long long totalTime = 0;
+	long long firstCuts = 0, cutoffs = 0;
+	int index = 0;
+	for (const char* fen : benchPositions)
+	{
+		Position pos = Position();
+		setFen(pos, fen);
+		clearHash(hashTable);
+		search(mainSearch, pos, benchLimits);
+
+		long long nodes = ::totalNodes(mainSearch);
+		long long time = elapsedTime(mainSearch);
+		totalNodes += nodes;
+		totalTime += time;
+		firstCuts += mainSearch.threads[0]->stats.cutoffs[0];
+		for (long long count : mainSearch.threads[0]->stats.cutoffs)
+		{
+			cutoffs += count;
+		}
+
+		const MoveList& bestMoves = mainSearch.threads[0]->chosenMoves;
+		std::cout << std::setw(8) << ++index << std::setw(14) << nodes << std::setw(10) << time
+			<< std::setw(8) << (bestMoves.size != 0 ? moveText(bestMoves.moves[0]) : "none") << std::endl;
+	}
+
+	std::cout << std::endl << "Depth: " << depth << std::endl
+		<< "Nodes: " << totalNodes << std::endl
+		<< "Time: " << totalTime << " ms" << std::endl
+		<< "NPS: " << totalNodes * 1000 / std::max(1LL, totalTime) << std::endl;
+
+	//how often the first move searched gave the cutoff, which measures the move ordering
+#if defined(STATS_BUILD)
+	std::cout << "First cut: " << std::fixed << std::setprecision(1) << 100.0 * firstCuts / std::max(1LL, cutoffs) << "%" << std::endl;
+	std::cout.unsetf(std::ios::floatfield);
+#endif
+
+	THREADS = threads;
+	tablebaseMen = men;
+	resizeHash(hashTable, HASH_SIZE_MB);
+}
+
+void microBenchmark()
+{
+	std::vector<Position> positions;
+	std::vector<MoveList> logs;
+	for (const char* fen : benchPositions)
+	{
+		positions.push_back(Position());
+		setFen(positions.back(), fen);
+		logs.push_back(MoveList());
+		logMoves(positions.back(), logs.back());
+	}
+
+	std::cout << std::left << std::setw(20) << "Operation" << std::right << std::setw(14) << "Calls" << std::setw(10) << "ns/call" << std::setw(14) << "Checksum" << std::endl;
+
+	//each operation runs over every bench position for half a second. Every result is summed, so that no
+	//call can be left out, and the sum for one pass shows whether a change altered the results
+	auto measure = [&](const char* name, int (*operation)(Position&, const MoveList&))
+	{
+		long long calls = 0, total = 0, passes = 0, time = 0;
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (; time < 500; passes++)
+		{
+			for (size_t k = 0; k < positions.size(); k++)
+			{
+				total += operation(positions[k], logs[k]);
+				calls++;
+			}
+			time = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+		long long checksum = total / passes;
+
+		long long nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		std::cout << std::left << std::setw(20) << name << std::right << std::setw(14) << calls << std::setw(10) << std::fixed << std::setprecision(1)
+			<< (double)nanoseconds / calls << std::setw(14) << checksum << std::endl;
+	};
+
+	measure("logMoves", [](Position& pos, const MoveList&)
+	{
+		MoveList log;
+		logMoves(pos, log);
+		return log.size;
+	});
+	measure("logMoves captures", [](Position& pos, const MoveList&)
+	{
+		MoveList log;
+		logMoves(pos, log, true);
+		return log.size;
+	});
+	measure("inCheck", [](Position& pos, const MoveList&)
+	{
+		return (int)inCheck(pos);
+	});
+	measure("evaluate", [](Position& pos, const MoveList&)
+	{
+		return evaluate(pos);
+	});
+	measure("makeMove all", [](Position& pos, const MoveList& log)
+	{
+		//every move of the position made and taken back
+		int pieces = 0;
+		for (int k = 0; k < log.size; k++)
+		{
+			Undo undo;
+			makeMove(pos, log.moves[k], undo);
+			pieces += popCount(pos.occupied);
+			unmakeMove(pos, log.moves[k], undo);
+		}
+		return pieces;
+	});
+}
+
+std::string moveText(Move move)
+{
+	std::string text;
+	text += (char)('a' + moveFrom(move) % 8);
+	text += (char)('1' + moveFrom(move) / 8);
+	text += (char)('a' + moveTo(move) % 8);
+	text += (char)('1' + moveTo(move) / 8);
+	if (promotionType(move) != 0)
+	{
+		text += "  rnbq"[promotionType(move)];
+	}
+	return text;
+}
+
+const unsigned char* mapFile(const std::string& path, size_t& size)
+{
+	//only the pages that are read are ever loaded from disk
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return nullptr;
+	}
+	LARGE_INTEGER length;
+	HANDLE mapping = GetFileSizeEx(file, &length) && length.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	void* data = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (mapping != nullptr)
+	{
+		CloseHandle(mapping);
+	}
+	CloseHandle(file);
+	if (data == nullptr)
+	{
+		return nullptr;
+	}
+	size = (size_t)length.QuadPart;
+#else
+	int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return nullptr;
+	}
+	struct stat status;
+	void* data = fstat(file, &status) == 0 && status.st_size > 0 ? mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, file, 0) : MAP_FAILED;
+	close(file);
+	if (data == MAP_FAILED)
+	{
+		return nullptr;
+	}
+	madvise(data, status.st_size, MADV_RANDOM);
+	size = (size_t)status.st_size;
+#endif
+
+	return (const unsigned char*)data;
+}
+
+void unmapFile(const unsigned char* data, size_t size)
+{
+#if defined(_WIN32)
+	(void)size;
+	UnmapViewOfFile(data);
+#else
+	munmap((void*)data, size);
+#endif
+}
+
+bool openBook(const std::string& path)
+{
+	closeBook();
+
+	bookData = mapFile(path, bookSize);
+	bookEntries = bookSize / 16;
+	if (bookData != nullptr && bookEntries == 0)
+	{
+		closeBook();
+	}
+	return bookData != nullptr;
+}
+
+void closeBook()
+{
+	if (bookData != nullptr)
+	{
+		unmapFile(bookData, bookSize);
+	}
+	bookData = nullptr;
+	bookEntries = 0;
+	bookSize = 0;
+}
+
+Key polyglotKey(const Position& pos)
+{
+	//black pieces come before white pieces of the same type
+	Key key = 0;
+	Bitboard pieces = pos.occupied;
+	while (pieces)
+	{
+		int square = popLsb(pieces);
+		int piece = pos.squares[square];
+		key ^= polyglotRandoms[64 * (2 * polyglotTypes[pieceType(piece)] + (pieceSide(piece) == WHITE)) + square];
+	}
+
+	//our castling rights are numbered in the same order as polyglot's
+	for (int k = 0; k < 4; k++)
+	{
+		if (pos.castling & 1 << k)
+		{
+			key ^= polyglotRandoms[768 + k];
+		}
+	}
+
+	//the en passant square is only kept when a pawn can capture onto it, as polyglot requires
+	if (pos.epSquare != NO_SQUARE)
+	{
+		key ^= polyglotRandoms[772 + pos.epSquare % 8];
+	}
+	if (pos.side == WHITE)
+	{
+		key ^= polyglotRandoms[780];
+	}
+	return key;
+}
+
+Move probeBook(Position& pos)
+{
+	if (bookData == nullptr || pos.moveCounter >= BOOK_DEPTH)
+	{
+		return NO_MOVE;
+	}
+
+	auto readBigEndian = [](const unsigned char* bytes, int size)
+	{
+		Key value = 0;
+		for (int k = 0; k < size; k++)
+		{
+			value = value << 8 | bytes[k];
+		}
+		return value;
+	};
+
+	//binary search for the first entry of the position; the others follow it
+	Key key = polyglotKey(pos);
+	size_t low = 0, high = bookEntries;
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+		if (readBigEndian(bookData + 16 * middle, 8) < key)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	//book moves are kept when they are legal here, which also guards against a different position with the same key
+	MoveList log;
+	logMoves(pos, log);
+	MoveList candidates;
+	int weights[MAX_MOVES];
+	int totalWeight = 0;
+	for (size_t index = low; index < bookEntries && candidates.size < MAX_MOVES; index++)
+	{
+		const unsigned char* entry = bookData + 16 * index;
+		if (readBigEndian(entry, 8) != key)
+		{
+			break;
+		}
+
+		//to square in bits 0-5 and from square in bits 6-11 as our own are, the promotion piece above them;
+		//castling is written as the king taking its own rook
+		int polyglotMove = (int)readBigEndian(entry + 8, 2);
+		int weight = (int)readBigEndian(entry + 10, 2);
+		int from = polyglotMove >> 6 & 63;
+		int to = polyglotMove & 63;
+		int promotion = polyglotPromotions[std::min(4, polyglotMove >> 12 & 7)];
+		if (pieceType(pos.squares[from]) == KING && pos.squares[to] == makePiece(ROOK, pos.side))
+		{
+			to = from + (to > from ? 2 : -2);
+		}
+
+		for (int k = 0; k < log.size; k++)
+		{
+			Move move = log.moves[k];
+			if (weight > 0 && moveFrom(move) == from && moveTo(move) == to && promotionType(move) == promotion)
+			{
+				weights[candidates.size] = weight;
+				addMove(candidates, move);
+				totalWeight += weight;
+			}
+		}
+	}
+	if (totalWeight == 0)
+	{
+		return NO_MOVE;
+	}
 
-				//check king moves
-				{
-					if (i + 1 <= 7)
-					{
-						if (board[i + 1][j] == 12)
-						{
-							return true;
-						}
+	//each thread draws from its own generator, seeded from the clock so games vary from run to run
+	thread_local Key seed = (Key)std::chrono::steady_clock::now().time_since_epoch().count() | 1;
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+	int pick = (int)((seed * 2685821657736338717ULL >> 32) % totalWeight);
+	for (int k = 0; k < candidates.size; k++)
+	{
+		pick -= weights[k];
+		if (pick < 0)
+		{
+			return candidates.moves[k];
+		}
+	}
+	return candidates.moves[candidates.size - 1];
+}
 
-						if (j + 1 <= 7)
-						{
-							if (board[i + 1][j + 1] == 12)
-							{
-								return true;
-							}
-						}
-						if (j - 1 >= 0)
-						{
-							if (board[i + 1][j - 1] == 12)
-							{
-								return true;
-							}
-						}
-					}
-					if (i - 1 >= 0)
-					{
-						if (board[i - 1][j] == 12)
-						{
-							return true;
-						}
+void bookCommand(const std::string& fen)
+{
+	Position pos = Position();
+	if (fen.empty())
+	{
+		initBoard(pos);
+	}
+	else if (!setFen(pos, fen))
+	{
+		std::cout << "Invalid fen " << fen << std::endl;
+		return;
+	}
 
-						if (j + 1 <= 7)
-						{
-							if (board[i - 1][j + 1] == 12)
-							{
-								return true;
-							}
-						}
-						if (j - 1 >= 0)
-						{
-							if (board[i - 1][j - 1] == 12)
-							{
-								return true;
-							}
-						}
-					}
-					if (j + 1 <= 7)
-					{
-						if (board[i][j + 1] == 12)
-						{
-							return true;
-						}
-					}
-					if (j - 1 >= 0)
-					{
-						if (board[i][j - 1] == 12)
-						{
-							return true;
-						}
-					}
-				}
-			}
+	//every move is drawn many times, so the counts show the weights at work as well as the time each probe takes
+	int depth = BOOK_DEPTH;
+	BOOK_DEPTH = pos.moveCounter + 1;
+	const int draws = 100000;
+	int counts[MAX_MOVES] = {};
+	MoveList log;
+	logMoves(pos, log);
+	long long startAllocations = threadAllocations;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int k = 0; k < draws; k++)
+	{
+		Move move = probeBook(pos);
+		counts[std::find(log.moves, log.moves + log.size, move) - log.moves]++;
+	}
+	long long elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	long long allocations = threadAllocations - startAllocations;
+	BOOK_DEPTH = depth;
+
+	std::cout << "Book entries: " << bookEntries << std::endl
+		<< "Key: " << std::hex << std::setfill('0') << std::setw(16) << polyglotKey(pos) << std::dec << std::setfill(' ') << std::endl
+		<< std::setw(8) << "Move" << std::setw(10) << "Played" << std::endl;
+	for (int k = 0; k < log.size; k++)
+	{
+		if (counts[k] > 0)
+		{
+			std::cout << std::setw(8) << sanText(pos, log.moves[k]) << std::setw(9) << std::fixed << std::setprecision(1) << 100.0 * counts[k] / draws << "%" << std::endl;
 		}
+	}
+	std::cout.unsetf(std::ios::floatfield);
+	if (counts[log.size] == draws)
+	{
+		std::cout << "The position is not in the book" << std::endl;
+	}
+	std::cout << "Probe: " << elapsed / draws << " ns, " << allocations << " heap allocations in " << draws << " probes" << std::endl;
+}
 
-	return false;
+bool makeTablebase(const std::string& name, Tablebase& tb)
+{
+	//each side's pieces are a king followed by any of "QRBNP", in that order once sorted
+	const std::string order = "QRBNP";
+	const std::string pieceLetters = "PRNBQK";
+	size_t separator = name.find('v');
+	if (separator == std::string::npos)
+	{
+		return false;
+	}
+	std::string sides[2] = { name.substr(0, separator), name.substr(separator + 1) };
+	int value[2] = { 0, 0 };
+	for (int side = 0; side < 2; side++)
+	{
+		if (sides[side].empty() || sides[side][0] != 'K' || sides[side].find_first_not_of(order, 1) != std::string::npos)
+		{
+			return false;
+		}
+		std::sort(sides[side].begin() + 1, sides[side].end(), [&](char a, char b) { return order.find(a) < order.find(b); });
+		for (size_t k = 1; k < sides[side].size(); k++)
+		{
+			value[side] += pieceValues[makePiece((int)pieceLetters.find(sides[side][k]) + 1, WHITE)];
+		}
+	}
+
+	//the stronger side is always white, so each material has one table
+	if (value[BLACK] > value[WHITE] || (value[BLACK] == value[WHITE] && sides[BLACK] > sides[WHITE]))
+	{
+		std::swap(sides[WHITE], sides[BLACK]);
+	}
+
+	tb = Tablebase();
+	tb.name = sides[WHITE] + "v" + sides[BLACK];
+	tb.count = (int)(sides[WHITE].size() + sides[BLACK].size());
+	if (tb.count > TABLEBASE_MEN)
+	{
+		return false;
+	}
+	tb.pieces[0] = makePiece(KING, WHITE);
+	tb.pieces[1] = makePiece(KING, BLACK);
+	int slot = 2;
+	for (int side = 0; side < 2; side++)
+	{
+		for (size_t k = 1; k < sides[side].size(); k++)
+		{
+			int piece = makePiece((int)pieceLetters.find(sides[side][k]) + 1, side);
+			tb.pieces[slot++] = piece;
+			tb.pawns |= pieceType(piece) == PAWN;
+		}
+	}
+	for (int k = 0; k < tb.count; k++)
+	{
+		int piece = tb.pieces[k];
+		tb.material += 1ULL << 4 * (piece - 1);
+		tb.mirrored += 1ULL << 4 * (pieceSide(piece) == WHITE ? piece : piece - 2);
+	}
+	tb.size = 2 * (tb.pawns ? 32 : 16);
+	for (int k = 1; k < tb.count; k++)
+	{
+		tb.size *= 64;
+	}
+	return true;
+}
+
+std::vector<std::string> tablebaseNames()
+{
+	//one or two pieces beside the kings, on either side; makeTablebase gives each material its one name
+	const std::string order = "QRBNP";
+	std::vector<std::string> names;
+	auto add = [&](const std::string& name)
+	{
+		Tablebase tb;
+		if (makeTablebase(name, tb) && std::find(names.begin(), names.end(), tb.name) == names.end())
+		{
+			names.push_back(tb.name);
+		}
+	};
+	for (char first : order)
+	{
+		add(std::string("K") + first + "vK");
+	}
+	for (char first : order)
+	{
+		for (char second : order)
+		{
+			add(std::string("K") + first + second + "vK");
+			add(std::string("K") + first + "vK" + second);
+		}
+	}
+	return names;
 }
 
-void logMoves()
+std::vector<std::string> tablebaseDependencies(const Tablebase& tb)
 {
-	std::vector<int> log;
+	size_t separator = tb.name.find('v');
+	std::string sides[2] = { tb.name.substr(0, separator), tb.name.substr(separator + 1) };
+	std::vector<std::string> names;
+	auto add = [&](const std::string& white, const std::string& black)
+	{
+		Tablebase dependency;
+		if (white.size() + black.size() > 2 && makeTablebase(white + "v" + black, dependency)
+			&& std::find(names.begin(), names.end(), dependency.name) == names.end())
+		{
+			names.push_back(dependency.name);
+		}
+	};
 
-	for (int i = 0; i <= 7; i++)
-		for (int j = 0; j <= 7; j++)
+	for (int side = 0; side < 2; side++)
+	{
+		std::string own = sides[side];
+		std::string other = sides[side ^ 1];
+		for (size_t k = 1; k < other.size(); k++)
 		{
-			//log all possible moves for white pawns
-			if (board[i][j] == 1 && moveCounter % 2 == 0)
+			//this side captures one of the other side's pieces, perhaps while promoting
+			std::string captured = other;
+			captured.erase(k, 1);
+			add(side == WHITE ? own : captured, side == WHITE ? captured : own);
+			for (size_t pawn = 1; pawn < own.size(); pawn++)
 			{
-				if (j + 1 <= 7)
+				for (char promoted : std::string("QRBN"))
 				{
-					if (board[i][j + 1] == 0)
-					{
-						if (j == 1 && board[i][j + 2] == 0)
-						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i);
-							log.push_back(j + 2);
-						}
-
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(i);
-						log.push_back(j + 1);
-					}
-					if (i - 1 >= 0)
-					{
-						if (board[i - 1][j + 1] != 0 && board[i - 1][j + 1] % 2 == 0)
-						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i - 1);
-							log.push_back(j + 1);
-						}
-					}
-					if (i + 1 <= 7)
-					{
-						if (board[i + 1][j + 1] != 0 && board[i + 1][j + 1] % 2 == 0)
-						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i + 1);
-							log.push_back(j + 1);
-						}
-					}
+					std::string promoting = own;
+					promoting[pawn] = own[pawn] == 'P' ? promoted : own[pawn];
+					add(side == WHITE ? promoting : captured, side == WHITE ? captured : promoting);
 				}
 			}
+		}
+		for (size_t pawn = 1; pawn < own.size(); pawn++)
+		{
+			for (char promoted : std::string("QRBN"))
+			{
+				std::string promoting = own;
+				promoting[pawn] = own[pawn] == 'P' ? promoted : own[pawn];
+				add(side == WHITE ? promoting : other, side == WHITE ? other : promoting);
+			}
+		}
+	}
+
+	//the material itself is not its own dependency
+	names.erase(std::remove(names.begin(), names.end(), tb.name), names.end());
+	return names;
+}
+
+size_t tablebaseIndex(const Tablebase& tb, int side, const int* squares)
+{
+	//turning the board over side to side, and without pawns top to bottom, gives the same result; neither leaves any square
+	//where it was, so no position is its own reflection, and every position stands for exactly two or four
+	int flip = 0;
+	if ((squares[0] & 7) > 3)
+	{
+		flip ^= 7;
+	}
+	if (!tb.pawns && squares[0] >> 3 > 3)
+	{
+		flip ^= 56;
+	}
+
+	//two pieces of the same kind are numbered lower square first
+	int folded[4];
+	for (int k = 0; k < tb.count; k++)
+	{
+		folded[k] = squares[k] ^ flip;
+	}
+	if (tb.count == 4 && tb.pieces[2] == tb.pieces[3] && folded[2] > folded[3])
+	{
+		std::swap(folded[2], folded[3]);
+	}
 
-			//log all possible moves for black pawns
-			if (board[i][j] == 1 && moveCounter % 2 == 1)
+	int king = squares[0] ^ flip;
+	size_t index = (size_t)side * (tb.pawns ? 32 : 16) + (king & 7) + 4 * (king >> 3);
+	for (int k = 1; k < tb.count; k++)
+	{
+		index = index * 64 + folded[k];
+	}
+	return index;
+}
+
+void tablebaseSquares(const Tablebase& tb, size_t index, int& side, int* squares)
+{
+	for (int k = tb.count - 1; k > 0; k--)
+	{
+		squares[k] = (int)(index % 64);
+		index /= 64;
+	}
+	int kings = tb.pawns ? 32 : 16;
+	squares[0] = (int)(index % kings % 4 + 8 * (index % kings / 4));
+	side = (int)(index / kings);
+}
+
+int probeTablebase(const Position& pos)
+{
+	int count = popCount(pos.occupied);
+	if (count == 2)
+	{
+		return 0;
+	}
+	if (count > tablebaseMen || pos.castling != 0 || pos.epSquare != NO_SQUARE)
+	{
+		return -1;
+	}
+
+	Key material = 0;
+	for (int piece = 1; piece <= 12; piece++)
+	{
+		material += (Key)popCount(pos.pieces[piece]) << 4 * (piece - 1);
+	}
+	for (const Tablebase& tb : tablebases)
+	{
+		if (tb.material != material && tb.mirrored != material)
+		{
+			continue;
+		}
+
+		//with the colours swapped the board is turned over too, so that white's pawns still move up it
+		int flip = tb.material != material;
+		Bitboard remaining[13];
+		std::copy(pos.pieces, pos.pieces + 13, remaining);
+		int squares[4];
+		for (int k = 0; k < tb.count; k++)
+		{
+			int piece = tb.pieces[k];
+			int own = !flip ? piece : pieceSide(piece) == WHITE ? piece + 1 : piece - 1;
+			squares[k] = popLsb(remaining[own]) ^ (flip ? 56 : 0);
+		}
+		return tb.data[tablebaseIndex(tb, pos.side ^ flip, squares)];
+	}
+	return -1;
+}
+
+int tablebaseScore(int value, int ply)
+{
+	//mates too far off for the search's scores still count as mates, though no longer by their distance
+	if (value == 0)
+	{
+		return 0;
+	}
+	int plies = std::min(ply + value - 1, MAX_PLY - 1);
+	return (value - 1) % 2 == 1 ? MATE_EVAL - plies : -MATE_EVAL + plies;
+}
+
+bool probeRoot(Position& pos, MoveList& best, int& eval)
+{
+	if (popCount(pos.occupied) > tablebaseMen || probeTablebase(pos) < 0)
+	{
+		return false;
+	}
+
+	MoveList log;
+	logMoves(pos, log);
+	best.size = 0;
+	eval = -INFINITE_EVAL;
+	for (int k = 0; k < log.size; k++)
+	{
+		Undo undo;
+		makeMove(pos, log.moves[k], undo);
+		int value = probeTablebase(pos);
+		unmakeMove(pos, log.moves[k], undo);
+
+		//a double push giving the chance to capture en passant leaves the tables
+		if (value < 0)
+		{
+			return false;
+		}
+
+		int score = -tablebaseScore(value, 1);
+		if (score > eval)
+		{
+			eval = score;
+			best.size = 0;
+		}
+		if (score == eval)
+		{
+			addMove(best, log.moves[k]);
+		}
+	}
+	return best.size > 0;
+}
+
+int loadTablebases(const std::string& directory)
+{
+	closeTablebases();
+	for (const std::string& name : tablebaseNames())
+	{
+		Tablebase tb;
+		makeTablebase(name, tb);
+		tb.data = mapFile(directory + "/" + name + ".dtm", tb.mapped);
+		if (tb.data != nullptr && tb.mapped != tb.size)
+		{
+			unmapFile(tb.data, tb.mapped);
+			tb.data = nullptr;
+		}
+		if (tb.data != nullptr)
+		{
+			tablebases.push_back(tb);
+			tablebaseMen = std::max(tablebaseMen, tb.count);
+		}
+	}
+	return (int)tablebases.size();
+}
+
+void closeTablebases()
+{
+	for (const Tablebase& tb : tablebases)
+	{
+		unmapFile(tb.data, tb.mapped);
+	}
+	tablebases.clear();
+	tablebaseMen = 0;
+}
+
+bool generateTablebase(const std::string& name, const std::string& directory, int threads)
+{
+	Tablebase tb;
+	if (!makeTablebase(name, tb))
+	{
+		return false;
+	}
+	for (const Tablebase& loaded : tablebases)
+	{
+		if (loaded.name == tb.name)
+		{
+			return true;
+		}
+	}
+
+	//a table already on disk is used as it is; deleting the file generates it again
+	std::string path = directory + "/" + tb.name + ".dtm";
+	tb.data = mapFile(path, tb.mapped);
+	if (tb.data != nullptr && tb.mapped != tb.size)
+	{
+		unmapFile(tb.data, tb.mapped);
+		tb.data = nullptr;
+	}
+	if (tb.data == nullptr)
+	{
+		//every table a capture or promotion leads to is needed first
+		for (const std::string& dependency : tablebaseDependencies(tb))
+		{
+			if (!generateTablebase(dependency, directory, threads))
 			{
-				if (j - 1 >= 0)
-				{
-					if (board[i][j - 1] == 0)
-					{
-						if (j == 6 && board[i][j - 2] == 0)
-						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i);
-							log.push_back(j -2);
-						}
+				return false;
+			}
+		}
 
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(i);
-						log.push_back(j - 1);
-					}
-					if (i - 1 >= 0)
-					{
-						if (board[i - 1][j - 1] != 0 && board[i - 1][j - 1] % 2 == 0)
-						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i - 1);
-							log.push_back(j - 1);
-						}
-					}
-					if (i + 1 <= 7)
-					{
-						if (board[i + 1][j - 1] != 0 && board[i + 1][j - 1] % 2 == 0)
-						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i + 1);
-							log.push_back(j - 1);
-						}
-					}
-				}
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		bool network = useNetwork;
+		useNetwork = false;
+
+		//retrograde analysis, a ply of distance to mate at a time, starting from the mates. values hold one more than
+		//the plies to mate, 0 while unknown and DRAWN for stalemates and positions that cannot arise. counters hold the
+		//moves staying in the table not yet known to lose, with HOLDS set when a capture or promotion saves the game
+		const unsigned char DRAWN = 255;
+		const unsigned char HOLDS = 128;
+		std::unique_ptr<std::atomic<unsigned char>[]> values(new std::atomic<unsigned char>[tb.size]);
+		std::unique_ptr<std::atomic<unsigned char>[]> counters(new std::atomic<unsigned char>[tb.size]);
+		std::unique_ptr<unsigned char[]> conversionLosses(new unsigned char[tb.size]); //plies to mate after the slowest losing capture or promotion
+		std::vector<std::vector<uint32_t>> pending(DRAWN); //positions whose distance is settled by a capture or promotion, by plies
+		std::vector<uint32_t> frontier; //positions whose distance to mate is the current number of plies
+		std::mutex merge;
+
+		//the tables hold no en passant rights, but a double push beside an enemy pawn leads to a position that has one.
+		//The opponent there may take en passant or play on as in the stored position without the right, so the push
+		//is worth the better of the two to them. With four men only pawn against pawn can meet this, and then the side
+		//to move has one double push at most. epReplies holds the opponent's best en passant capture after it, in the
+		//table's encoding from their side, DRAWN for a draw and 0 when there is none. When that capture wins, the push
+		//is known to lose by then at the latest: epResolves lists the positions by that distance, and epPending marks
+		//the push as not yet counted off
+		bool enPassant = std::count(tb.pieces, tb.pieces + tb.count, makePiece(PAWN, WHITE)) != 0
+			&& std::count(tb.pieces, tb.pieces + tb.count, makePiece(PAWN, BLACK)) != 0;
+		std::vector<unsigned char> epReplies(enPassant ? tb.size : 0);
+		std::unique_ptr<std::atomic<unsigned char>[]> epPending(new std::atomic<unsigned char>[enPassant ? tb.size : 0]);
+		std::vector<std::vector<uint32_t>> epResolves(DRAWN);
+
+		//each thread takes an equal share of the range
+		auto parallel = [threads](size_t count, auto work)
+		{
+			std::vector<std::thread> pool;
+			for (int t = 0; t < threads; t++)
+			{
+				pool.emplace_back([=, &work]() { work(count * t / threads, count * (t + 1) / threads); });
+			}
+			for (std::thread& thread : pool)
+			{
+				thread.join();
 			}
+		};
 
-			//log all possible rook/queen moves
-			if (board[i][j] == 3 || board[i][j] == 9)
+		//every position is set up once to count its moves and look its captures and promotions up in the smaller tables
+		parallel(tb.size, [&](size_t begin, size_t end)
+		{
+			Position pos = Position();
+			std::vector<uint32_t> mates;
+			std::vector<std::pair<int, uint32_t>> settled;
+			std::vector<std::pair<int, uint32_t>> capped;
+			for (size_t index = begin; index < end; index++)
 			{
-				for (int k = i + 1; k <= 7; k++)
+				int side, squares[4];
+				tablebaseSquares(tb, index, side, squares);
+				values[index] = DRAWN;
+				counters[index] = 0;
+				conversionLosses[index] = 0;
+				if (enPassant)
 				{
-					if (board[k][j] % 2 == 1)
-					{
-						break;
-					}
-
-					if (board[k][j] == 0)
-					{
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(k);
-						log.push_back(j);
-					}
-					else if (board[k][j] % 2 == 0)
-					{
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(k);
-						log.push_back(j);
-						break;
-					}
+					epReplies[index] = 0;
+					epPending[index] = 0;
 				}
-				for (int k = i - 1; k >= 0; k--)
-				{
-					if (board[k][j] % 2 == 1)
-					{
-						break;
-					}
 
-					if (board[k][j] == 0)
-					{
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(k);
-						log.push_back(j);
-					}
-					else if (board[k][j] % 2 == 0)
-					{
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(k);
-						log.push_back(j);
-						break;
-					}
-				}
-				for (int k = j + 1; k <= 7; k++)
+				//overlapping pieces, pawns on the first or last rank, and the lower numbered of two like pieces on the higher square
+				Bitboard occupied = 0;
+				bool valid = !(tb.count == 4 && tb.pieces[2] == tb.pieces[3] && squares[2] > squares[3]);
+				for (int k = 0; k < tb.count; k++)
 				{
-					if (board[i][k] % 2 == 1)
-					{
-						break;
-					}
-
-					if (board[i][k] == 0)
-					{
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(i);
-						log.push_back(k);
-					}
-					else if (board[i][k] % 2 == 0)
-					{
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(i);
-						log.push_back(k);
-						break;
-					}
+					valid &= !(occupied >> squares[k] & 1) && !(pieceType(tb.pieces[k]) == PAWN && (squares[k] < 8 || squares[k] >= 56));
+					occupied |= 1ULL << squares[k];
 				}
-				for (int k = j - 1; k >= 0; k--)
+				if (!valid)
 				{
-					if (board[i][k] % 2 == 1)
-					{
-						break;
-					}
+					continue;
+				}
 
-					if (board[i][k] == 0)
-					{
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(i);
-						log.push_back(k);
-					}
-					else if (board[i][k] % 2 == 0)
-					{
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(i);
-						log.push_back(k);
-						break;
-					}
+				for (int k = 0; k < tb.count; k++)
+				{
+					putPiece(pos, tb.pieces[k], squares[k]);
 				}
-			}
+				pos.side = side;
 
-			//log all possible knight moves
-			if (board[i][j] == 5)
-			{
-				if (i + 2 <= 7)
+				//the side that has just moved cannot be left in check
+				if (!squareAttacked(pos, pos.kingSquares[side ^ 1], side))
 				{
-					if (j + 1 <= 7)
+					MoveList log;
+					logMoves(pos, log);
+					int moves = 0;
+					int fastestWin = DRAWN;
+					int slowestLoss = 0;
+					bool holds = false;
+					for (int k = 0; k < log.size; k++)
 					{
-						if (board[i + 2][j + 1] % 2 == 0)
+						Move move = log.moves[k];
+						if (moveFlags(move) == DOUBLE_PUSH && enPassant)
 						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i + 2);
-							log.push_back(j + 1);
+							//the opponent's best en passant capture, scored from their side
+							Undo undo;
+							makeMove(pos, move, undo);
+							MoveList replies;
+							logMoves(pos, replies, true);
+							int win = DRAWN, loss = 0;
+							bool draw = false;
+							for (int r = 0; r < replies.size; r++)
+							{
+								if (moveFlags(replies.moves[r]) != EN_PASSANT)
+								{
+									continue;
+								}
+								Undo replyUndo;
+								makeMove(pos, replies.moves[r], replyUndo);
+								int value = probeTablebase(pos);
+								unmakeMove(pos, replies.moves[r], replyUndo);
+								if (value <= 0)
+								{
+									draw = true;
+								}
+								else if ((value - 1) % 2 == 0)
+								{
+									win = std::min(win, value + 1);
+								}
+								else
+								{
+									loss = std::max(loss, value + 1);
+								}
+							}
+							unmakeMove(pos, move, undo);
+
+							epReplies[index] = (unsigned char)(win != DRAWN ? win : draw ? DRAWN : loss);
+							if (win != DRAWN)
+							{
+								epPending[index] = 1;
+								capped.emplace_back(win - 1, (uint32_t)index);
+							}
 						}
-					}
-					if (j - 1 >= 0)
-					{
-						if (board[i + 2][j - 1] % 2 == 0)
+						if (!isCapture(move) && promotionType(move) == 0)
 						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i + 2);
-							log.push_back(j - 1);
+							moves++;
+							continue;
 						}
-					}
-				}
-				if (i - 2 >= 0)
-				{
-					if (j + 1 <= 7)
-					{
-						if (board[i - 2][j + 1] % 2 == 0)
+
+						Undo undo;
+						makeMove(pos, move, undo);
+						int value = probeTablebase(pos);
+						unmakeMove(pos, move, undo);
+						if (value <= 0)
 						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i - 2);
-							log.push_back(j + 1);
+							holds = true;
 						}
-					}
-					if (j - 1 >= 0)
-					{
-						if (board[i - 2][j - 1] % 2 == 0)
+						else if ((value - 1) % 2 == 0)
 						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i - 2);
-							log.push_back(j - 1);
+							fastestWin = std::min(fastestWin, value);
 						}
-					}
-				}
-				if (j + 2 <= 7)
-				{
-					if (i + 1 <= 7)
-					{
-						if (board[i + 1][j + 2] % 2 == 0)
+						else
 						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i + 1);
-							log.push_back(j + 2);
+							slowestLoss = std::max(slowestLoss, value);
 						}
 					}
-					if (i - 1 >= 0)
+
+					if (log.size == 0 && inCheck(pos))
 					{
-						if (board[i - 1][j + 2] % 2 == 0)
-						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i - 1);
-							log.push_back(j + 2);
-						}
+						values[index] = 1;
+						mates.push_back((uint32_t)index);
 					}
-				}
-				if (j - 2 >= 0)
-				{
-					if (i + 1 <= 7)
+					else if (log.size != 0)
 					{
-						if (board[i + 1][j - 2] % 2 == 0)
+						values[index] = 0;
+						counters[index] = (unsigned char)(moves | (holds || fastestWin != DRAWN ? HOLDS : 0));
+						conversionLosses[index] = (unsigned char)slowestLoss;
+						if (fastestWin != DRAWN)
 						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i + 1);
-							log.push_back(j - 2);
+							settled.emplace_back(fastestWin, (uint32_t)index);
 						}
-					}
-					if (i - 1 >= 0)
-					{
-						if (board[i - 1][j - 2] % 2 == 0)
+						else if (moves == 0 && !holds)
 						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i - 1);
-							log.push_back(j - 2);
+							settled.emplace_back(slowestLoss, (uint32_t)index);
 						}
 					}
 				}
+
+				for (int k = 0; k < tb.count; k++)
+				{
+					removePiece(pos, squares[k]);
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(merge);
+			frontier.insert(frontier.end(), mates.begin(), mates.end());
+			for (const std::pair<int, uint32_t>& entry : settled)
+			{
+				pending[entry.first].push_back(entry.second);
 			}
+			for (const std::pair<int, uint32_t>& entry : capped)
+			{
+				epResolves[entry.first].push_back(entry.second);
+			}
+		});
 
-			//log all possible bishop moves
-			if (board[i][j] == 7 || board[i][j] == 9)
+		//the positions a ply further from mate are found by taking back a move, which never captures or promotes,
+		//from each position settled at this distance
+		for (int plies = 0; plies + 1 < DRAWN; plies++)
+		{
+			for (uint32_t index : pending[plies])
 			{
-				for (int k = 1; k <= 7; k++)
+				unsigned char unknown = 0;
+				if (values[index].compare_exchange_strong(unknown, (unsigned char)(plies + 1)))
 				{
-					if (i + k <= 7)
-					{
-						if (j + k <= 7)
-						{
-							if (board[i + k][j + k] % 2 == 1)
-							{
-								break;
-							}
+					frontier.push_back(index);
+				}
+			}
+			std::vector<uint32_t>().swap(pending[plies]);
 
-							if (board[i + k][j + k] == 0)
-							{
-								log.push_back(i);
-								log.push_back(j);
-								log.push_back(i + k);
-								log.push_back(j + k);
-							}
-							else if (board[i + k][j + k] % 2 == 0)
-							{
-								log.push_back(i);
-								log.push_back(j);
-								log.push_back(i + k);
-								log.push_back(j + k);
-								break;
-							}
-						}
-					}
+			//a double push the opponent wins by taking en passant loses by now, if the position it leads to has not
+			//already been found lost sooner
+			for (uint32_t index : epResolves[plies])
+			{
+				if (values[index] == 0 && epPending[index].exchange(0) == 1 && counters[index].fetch_sub(1) == 1)
+				{
+					int lost = std::max(plies + 1, (int)conversionLosses[index]);
+					pending[std::min(lost, DRAWN - 1)].push_back(index);
 				}
-				for (int k = 1; k <= 7; k++)
+			}
+			std::vector<uint32_t>().swap(epResolves[plies]);
+
+			bool later = false;
+			for (int k = plies + 1; k < DRAWN; k++)
+			{
+				later |= !pending[k].empty() || !epResolves[k].empty();
+			}
+			if (frontier.empty() && !later)
+			{
+				break;
+			}
+
+			std::vector<uint32_t> next;
+			parallel(frontier.size(), [&](size_t begin, size_t end)
+			{
+				std::vector<uint32_t> found;
+				std::vector<std::pair<int, uint32_t>> settled;
+				for (size_t k = begin; k < end; k++)
 				{
-					if (i + k <= 7)
+					int side, squares[4];
+					tablebaseSquares(tb, frontier[k], side, squares);
+					Bitboard occupied = 0;
+					for (int piece = 0; piece < tb.count; piece++)
+					{
+						occupied |= 1ULL << squares[piece];
+					}
+
+					//the other side made the last move
+					int mover = side ^ 1;
+					for (int piece = 0; piece < tb.count; piece++)
 					{
-						if (j - k >= 0)
+						int type = pieceType(tb.pieces[piece]);
+						int from = squares[piece];
+						if (pieceSide(tb.pieces[piece]) != mover)
 						{
-							if (board[i + k][j - k] % 2 == 1)
-							{
-								break;
-							}
+							continue;
+						}
 
-							if (board[i + k][j - k] == 0)
-							{
-								log.push_back(i);
-								log.push_back(j);
-								log.push_back(i + k);
-								log.push_back(j - k);
-							}
-							else if (board[i + k][j - k] % 2 == 0)
+						Bitboard origins = 0;
+						if (type == PAWN)
+						{
+							int back = mover == WHITE ? -8 : 8;
+							int rank = mover == WHITE ? from >> 3 : 7 - (from >> 3);
+							if (rank >= 2 && !(occupied >> (from + back) & 1))
 							{
-								log.push_back(i);
-								log.push_back(j);
-								log.push_back(i + k);
-								log.push_back(j - k);
-								break;
+								origins |= 1ULL << (from + back);
+								if (rank == 3 && !(occupied >> (from + 2 * back) & 1))
+								{
+									origins |= 1ULL << (from + 2 * back);
+								}
 							}
 						}
-					}
-				}
-				for (int k = 1; k <= 7; k++)
-				{
-					if (i - k >= 0)
-					{
-						if (j + k <= 7)
+						else
 						{
-							if (board[i - k][j + k] % 2 == 1)
-							{
-								break;
-							}
+							origins = type == KING ? kingAttacks[from] : type == KNIGHT ? knightAttacks[from]
+								: (type != BISHOP ? rookAttacks(from, occupied) : 0) | (type != ROOK ? bishopAttacks(from, occupied) : 0);
+							origins &= ~occupied;
+						}
 
-							if (board[i - k][j + k] == 0)
-							{
-								log.push_back(i);
-								log.push_back(j);
-								log.push_back(i - k);
-								log.push_back(j + k);
-							}
-							else if (board[i - k][j + k] % 2 == 0)
+						while (origins)
+						{
+							squares[piece] = popLsb(origins);
+							size_t previous = tablebaseIndex(tb, mover, squares);
+							if (values[previous].load(std::memory_order_relaxed) != 0)
 							{
-								log.push_back(i);
-								log.push_back(j);
-								log.push_back(i - k);
-								log.push_back(j + k);
-								break;
+								continue;
 							}
-						}
-					}
-				}
-				for (int k = 1; k <= 7; k++)
-				{
-					if (i - k >= 0)
-					{
-						if (j - k >= 0)
-						{
-							if (board[i - k][j - k] % 2 == 1)
+
+							//a double push the opponent can answer en passant is worth to them the better of that
+							//capture and this position
+							int reply = type == PAWN && enPassant && (squares[piece] ^ from) == 16 ? epReplies[previous] : 0;
+							if (reply != 0)
 							{
-								break;
+								bool replyWins = reply != DRAWN && (reply - 1) % 2 == 1;
+								if (plies % 2 == 0)
+								{
+									//lost here, so the push wins unless the capture holds, and no sooner than the capture loses
+									if (reply == DRAWN || replyWins)
+									{
+										continue;
+									}
+									if (reply - 1 > plies)
+									{
+										settled.emplace_back(reply, (uint32_t)previous);
+										continue;
+									}
+								}
+								else if (replyWins && epPending[previous].exchange(0) != 1)
+								{
+									//won here, but the capture has already won sooner and counted the push off
+									continue;
+								}
 							}
 
-							if (board[i - k][j - k] == 0)
+							//a move into a lost position wins; the position is lost once every move leads to a win
+							if (plies % 2 == 0)
 							{
-								log.push_back(i);
-								log.push_back(j);
-								log.push_back(i - k);
-								log.push_back(j - k);
+								unsigned char unknown = 0;
+								if (values[previous].compare_exchange_strong(unknown, (unsigned char)(plies + 2)))
+								{
+									found.push_back((uint32_t)previous);
+								}
 							}
-							else if (board[i - k][j - k] % 2 == 0)
+							else if (counters[previous].fetch_sub(1) == 1)
 							{
-								log.push_back(i);
-								log.push_back(j);
-								log.push_back(i - k);
-								log.push_back(j - k);
-								break;
+								int lost = std::max(plies + 1, (int)conversionLosses[previous]);
+								settled.emplace_back(lost, (uint32_t)previous);
 							}
 						}
+						squares[piece] = from;
 					}
 				}
-			}
-			
-			//log all possible king moves
-			if (board[i][j] == 11)
-			{
-				if (i + 1 <= 7)
-				{
-					if (board[i + 1][j] % 2 == 0)
-					{
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(i + 1);
-						log.push_back(j);
-					}
-					if (j + 1 <= 7)
-					{
-						if (board[i + 1][j + 1] % 2 == 0)
-						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i + 1);
-							log.push_back(j + 1);
-						}
-					}
-					if (j - 1 >= 0)
-					{
-						if (board[i + 1][j - 1] % 2 == 0)
-						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i + 1);
-							log.push_back(j - 1);
-						}
-					}
-				}
-				if (i - 1 >= 0)
-				{
-					if (board[i - 1][j] % 2 == 0)
-					{
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(i - 1);
-						log.push_back(j);
-					}
-					if (j + 1 <= 7)
-					{
-						if (board[i - 1][j + 1] % 2 == 0)
-						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i - 1);
-							log.push_back(j + 1);
-						}
-					}
-					if (j - 1 >= 0)
-					{
-						if (board[i - 1][j - 1] % 2 == 0)
-						{
-							log.push_back(i);
-							log.push_back(j);
-							log.push_back(i - 1);
-							log.push_back(j - 1);
-						}
-					}
-				}
-				if (j + 1 <= 7)
-				{
-					if (board[i][j + 1] % 2 == 0)
-					{
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(i);
-						log.push_back(j + 1);
-					}
-				}
-				if (j - 1 >= 0)
+
+				std::lock_guard<std::mutex> lock(merge);
+				next.insert(next.end(), found.begin(), found.end());
+				for (const std::pair<int, uint32_t>& entry : settled)
 				{
-					if (board[i][j - 1] % 2 == 0)
-					{
-						log.push_back(i);
-						log.push_back(j);
-						log.push_back(i);
-						log.push_back(j - 1);
-					}
+					pending[std::min(entry.first, DRAWN - 1)].push_back(entry.second);
 				}
+			});
+			frontier.swap(next);
+		}
+
+		std::vector<unsigned char> table(tb.size);
+		int longest[2] = { 0, 0 }; //plies of the longest win with each side to move
+		for (size_t index = 0; index < tb.size; index++)
+		{
+			unsigned char value = values[index];
+			table[index] = value == DRAWN ? 0 : value;
+			if (value != DRAWN && value % 2 == 0)
+			{
+				int side = (int)(index / (tb.size / 2));
+				longest[side] = std::max(longest[side], value - 1);
 			}
 		}
+		useNetwork = network;
+
+		std::error_code error;
+		std::filesystem::create_directories(directory, error);
+		std::ofstream file(path, std::ios::binary);
+		if (!file.write((const char*)table.data(), table.size()))
+		{
+			std::cout << "Could not write " << path << std::endl;
+			return false;
+		}
+		file.close();
+
+		long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		std::cout << std::left << std::setw(8) << tb.name << std::right << std::setw(12) << tb.size << " positions, longest mate "
+			<< (longest[WHITE] + 1) / 2 << " moves with white to move, " << (longest[BLACK] + 1) / 2 << " with black, "
+			<< std::fixed << std::setprecision(1) << elapsed / 1000.0 << " s" << std::endl;
+		std::cout.unsetf(std::ios::floatfield);
+
+		tb.data = mapFile(path, tb.mapped);
+		if (tb.data == nullptr)
+		{
+			std::cout << "Could not read " << path << std::endl;
+			return false;
+		}
+	}
+
+	tablebases.push_back(tb);
+	tablebaseMen = std::max(tablebaseMen, tb.count);
+	return true;
+}
+
+void uciLoop(std::string line)
+{
+	//the reader stays on this thread and each search runs on a worker, so "stop" and "isready"
+	//are answered while the engine thinks
+	uciMode = true;
+	board = Position();
+	initBoard(board);
+
+	do
+	{
+		std::istringstream stream(line);
+		std::string token;
+		stream >> token;
+
+		if (token == "uci")
+		{
+			uciSend("id name Chess-Client");
+			uciSend("id author Chess-Client contributors");
+			uciSend("option name Hash type spin default " + std::to_string(HASH_SIZE_MB) + " min 1 max 65536");
+			uciSend("option name Threads type spin default " + std::to_string(THREADS) + " min 1 max 256");
+			uciSend("option name Ponder type check default false");
+			uciSend("option name EvalFile type string default <empty>");
+			uciSend("option name BookFile type string default <empty>");
+			uciSend("option name BookDepth type spin default " + std::to_string(BOOK_DEPTH) + " min 0 max 1000");
+			uciSend("option name TablebasePath type string default " + TABLEBASE_PATH);
+			uciSend("uciok");
+		}
+		else if (token == "isready")
+		{
+			uciSend("readyok");
+		}
+		else if (token == "ucinewgame")
+		{
+			uciStop();
+			clearHash(hashTable);
+		}
+		else if (token == "position")
+		{
+			uciStop();
+			uciPosition(stream);
+		}
+		else if (token == "go")
+		{
+			uciStop();
+			uciGo(stream);
+		}
+		else if (token == "stop")
+		{
+			uciStop();
+		}
+		//the opponent played the expected move, so the search carries on with the clock now running
+		else if (token == "ponderhit")
+		{
+			mainSearch.start = std::chrono::steady_clock::now();
+			mainSearch.pondering = false;
+		}
+		else if (token == "setoption")
+		{
+			uciStop();
+			uciSetOption(stream);
+		}
+		else if (token == "quit")
+		{
+			break;
+		}
+	} while (std::getline(std::cin, line));
+
+	uciStop();
+}
+
+void uciPosition(std::istringstream& stream)
+{
+	//"position startpos moves e2e4 e7e5" or "position fen <fen> moves ..."
+	std::string token;
+	stream >> token;
+
+	Position pos = Position();
+	if (token == "startpos")
+	{
+		initBoard(pos);
+		stream >> token;
+	}
+	else if (token == "fen")
+	{
+		std::string fen;
+		while (stream >> token && token != "moves")
+		{
+			fen += token + " ";
+		}
+		if (!setFen(pos, fen))
+		{
+			uciSend("info string invalid fen " + fen);
+			uciInvalid = true;
+			return;
+		}
+	}
+	else
+	{
+		uciInvalid = true;
+		return;
+	}
+
+	if (token == "moves")
+	{
+		std::string moves;
+		std::getline(stream, moves);
+		playMoves(pos, moves);
+	}
+	board = pos;
+	uciInvalid = false;
+}
+
+void uciGo(std::istringstream& stream)
+{
+	SearchLimits goLimits;
+	goLimits.moveTime = 0;
+	long long time[2] = { 0, 0 };
+	long long increment[2] = { 0, 0 };
+	int movesToGo = 0;
+	bool timed = false;
+	bool ponder = false;
+
+	std::string token;
+	while (stream >> token)
+	{
+		if (token == "wtime") { stream >> time[WHITE]; timed = true; }
+		else if (token == "btime") { stream >> time[BLACK]; timed = true; }
+		else if (token == "winc") { stream >> increment[WHITE]; }
+		else if (token == "binc") { stream >> increment[BLACK]; }
+		else if (token == "movestogo") { stream >> movesToGo; }
+		else if (token == "depth") { stream >> goLimits.depth; goLimits.depth = std::max(1, std::min(goLimits.depth, MAX_PLY - 1)); }
+		else if (token == "nodes") { stream >> goLimits.nodes; }
+		else if (token == "movetime") { stream >> goLimits.moveTime; }
+		else if (token == "infinite") { goLimits.infinite = true; }
+		else if (token == "ponder") { ponder = true; }
+	}
+
+	if (timed && goLimits.moveTime == 0)
+	{
+		goLimits.moveTime = uciMoveTime(time[board.side], increment[board.side], movesToGo);
+	}
+	//the previous position is not searched in place of one the GUI sent and could not be set up
+	if (uciInvalid)
+	{
+		uciSend("bestmove 0000");
+		return;
+	}
+
+	mainSearch.stopRequested = false;
+	mainSearch.pondering = ponder;
 
-	//filter out moves that keep us in check
-	if (inCheck())
+	//a book move is answered at once, unless the GUI has asked for a search that waits to be told to stop
+	Move bookMove = !ponder && !goLimits.infinite ? probeBook(board) : NO_MOVE;
+	if (bookMove != NO_MOVE)
 	{
-		//log all that moves that escape us from checks
-		std::vector<int> escapeLog;
-		for (int i = 0; i < log.size(); i += 4)
+		uciSend("info string book move");
+		uciSend("bestmove " + moveText(bookMove));
+		return;
+	}
+
+	uciWorker = std::thread([goLimits]()
+	{
+		search(mainSearch, board, goLimits);
+
+		//a pondering or infinite search keeps its move back until the GUI asks for it
+		while ((mainSearch.pondering || goLimits.infinite) && !mainSearch.stopRequested)
 		{
-			int fromValue = board[log[i]][log[i + 1]];
-			int toValue = board[log[i + 2]][log[i + 3]];
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		const MoveList& bestMoves = mainSearch.threads[0]->chosenMoves;
+		if (bestMoves.size == 0)
+		{
+			uciSend("bestmove 0000");
+			return;
+		}
 
-			//make the move
-			board[log[i + 2]][log[i + 3]] = board[log[i]][log[i + 1]];
-			board[log[i]][log[i + 1]] = 0;
+		//the reply the table expects is offered to ponder on
+		MoveList pv;
+		hashPv(board, bestMoves.moves[0], 2, pv);
+		uciSend("bestmove " + moveText(pv.moves[0]) + (pv.size > 1 ? " ponder " + moveText(pv.moves[1]) : ""));
+	});
+}
+
+void uciSetOption(std::istringstream& stream)
+{
+	//"setoption name <name> value <value>", where both may hold spaces
+	std::string token, name, value;
+	stream >> token;
+	while (stream >> token && token != "value")
+	{
+		name += (name.empty() ? "" : " ") + token;
+	}
+	std::getline(stream >> std::ws, value);
 
-			//if we escape the check, record the move
-			if (!inCheck())
+	if (name == "Hash")
+	{
+		HASH_SIZE_MB = std::max(1, atoi(value.c_str()));
+		resizeHash(hashTable, HASH_SIZE_MB);
+	}
+	else if (name == "Threads")
+	{
+		THREADS = std::max(1, atoi(value.c_str()));
+	}
+	//the accumulators are built as the next position is set up
+	else if (name == "EvalFile")
+	{
+		useNetwork = false;
+		if (!value.empty() && value != "<empty>")
+		{
+			if (loadNetwork(value))
 			{
-				for (int j = i; j <= i + 3; j++)
-				{
-					escapeLog.push_back(log[j]);
-				}
+				useNetwork = true;
+			}
+			else
+			{
+				uciSend("info string could not load the network from " + value);
 			}
+		}
+	}
+	else if (name == "BookFile")
+	{
+		closeBook();
+		if (!value.empty() && value != "<empty>" && !openBook(value))
+		{
+			uciSend("info string could not open the book " + value);
+		}
+	}
+	else if (name == "BookDepth")
+	{
+		BOOK_DEPTH = std::max(0, atoi(value.c_str()));
+	}
+	else if (name == "TablebasePath")
+	{
+		TABLEBASE_PATH = value;
+		uciSend("info string " + std::to_string(loadTablebases(value)) + " endgame tables loaded");
+	}
+}
+
+void uciStop()
+{
+	if (uciWorker.joinable())
+	{
+		mainSearch.stopRequested = true;
+		uciWorker.join();
+	}
+}
+
+void uciInfo(const SearchThread& thread, int depth, int eval)
+{
+	long long time = elapsedTime(*thread.context);
+	long long nodes = totalNodes(*thread.context);
+	MoveList pv;
+	hashPv(thread.board, thread.chosenMoves.moves[0], depth, pv);
+
+	std::ostringstream line;
+	line << "info depth " << depth;
+	if (std::abs(eval) >= MATE_BOUND)
+	{
+		//in moves rather than plies, negative when being mated
+		line << " score mate " << (eval > 0 ? (MATE_EVAL - eval + 1) / 2 : -(MATE_EVAL + eval + 1) / 2);
+	}
+	else
+	{
+		line << " score cp " << eval;
+	}
+	line << " nodes " << nodes << " nps " << nodes * 1000 / std::max(1LL, time) << " hashfull " << hashFull(hashTable) << " time " << time << " pv";
+	for (int k = 0; k < pv.size; k++)
+	{
+		line << " " << moveText(pv.moves[k]);
+	}
+	uciSend(line.str());
+}
+
+void uciSend(const std::string& line)
+{
+	std::lock_guard<std::mutex> lock(uciOutput);
+	std::cout << line << std::endl;
+}
 
-			//undo the move
-			board[log[i]][log[i + 1]] = fromValue;
-			board[log[i + 2]][log[i + 3]] = toValue;
+void hashPv(const Position& root, Move first, int depth, MoveList& pv)
+{
+	//follows the table's moves from the position the first leads to, stopping at a missing or
+	//unavailable move, or once as many moves as the search was deep, which also ends any cycle
+	Position pos = root;
+	pv.size = 0;
+	Move move = first;
+	while (move != NO_MOVE && pv.size < std::max(1, depth))
+	{
+		MoveList log;
+		logMoves(pos, log);
+		if (std::find(log.moves, log.moves + log.size, move) == log.moves + log.size)
+		{
+			break;
 		}
 
-		log = escapeLog;
+		addMove(pv, move);
+		Undo undo;
+		makeMove(pos, move, undo);
+
+		HashEntry entry;
+		move = probeHash(hashTable, pos.key, entry) ? entry.move : NO_MOVE;
 	}
+}
 
-	moveLog = log;
-	log.clear();
+int uciMoveTime(long long time, long long increment, int movesToGo)
+{
+	//an even share of the clock over the moves left to the time control, or thirty more when there
+	//is none, plus most of the increment, never running the clock down to the last moments
+	long long share = time / (movesToGo > 0 ? movesToGo + 1 : 30) + increment * 3 / 4;
+	return (int)std::max(1LL, std::min(share, time - MOVE_OVERHEAD));
 }